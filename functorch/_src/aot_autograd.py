@@ -1,3 +1,4 @@
+import itertools
 import torch
 import torch.nn as nn
 from torch import Tensor
@@ -6,7 +7,7 @@ from torch.fx import immutable_collections
 import torch.utils._pytree as pytree
 import torch.utils.dlpack
 from torch.nn.utils import _stateless
-from functorch._C import CompileCache
+from functorch._C import CompileCache, HasherType
 from .decompositions import register_decomposition
 from .partitioners import default_partition
 from typing import Callable, List, Dict, Any, Tuple, Optional
@@ -169,9 +170,41 @@ def create_aot_autograd_function(
             out = normalize_as_list(compiled_bw(*ctx.saved_tensors, *contiguous_args))
             return tuple(out)
 
+        @staticmethod
+        def compiled_nbytes():
+            return _compiled_nbytes(compiled_fw) + _compiled_nbytes(compiled_bw)
+
     return CompiledFunction
 
 
+def _compiled_nbytes(compiled):
+    """
+    Estimates the memory held by a compiled forward or backward graph from the
+    storages of the tensors it owns: its parameters, buffers and tensor
+    attributes, plus the tensor constants of TorchScript graphs, which is where
+    the weights of the frozen modules returned by ts_compile end up. The
+    generated code itself is not accounted for.
+    """
+    if not isinstance(compiled, torch.nn.Module):
+        return 0
+    tensors = itertools.chain(compiled.parameters(), compiled.buffers(), vars(compiled).values())
+    if isinstance(compiled, torch.jit.ScriptModule):
+        tensors = itertools.chain(tensors, _graph_tensor_constants(compiled.inlined_graph))
+    storages = {}
+    for t in tensors:
+        if isinstance(t, Tensor):
+            storage = t.storage()
+            storages[(t.device, storage.data_ptr())] = storage.size() * storage.element_size()
+    return sum(storages.values())
+
+
+def _graph_tensor_constants(graph):
+    for node in graph.findAllNodes("prim::Constant"):
+        output = node.output()
+        if isinstance(output.type(), torch._C.TensorType):
+            yield output.toIValue()
+
+
 class _CompileCache(CompileCache):
     pass
 
@@ -184,6 +217,7 @@ try:
 except ImportError:
     HAS_TREE = False
 compile_cache = None
+compile_cache_capacity = {"max_entries": 0, "max_bytes": 0}
 
 
 # Inspired by autodidax (thanks!)
@@ -338,6 +372,7 @@ def aot_function(
     global compile_cache
     if compile_cache is None:
         compile_cache = CompileCache()
+        compile_cache.set_capacity(**compile_cache_capacity)
     if bw_compiler is None:
         bw_compiler = fw_compiler
     cached_res = None
@@ -346,6 +381,12 @@ def aot_function(
     fw_compiler_id = id(fw_compiler)
     bw_compiler_id = id(bw_compiler)
 
+    # Resolve the hasher once here instead of on every call
+    if hasher_type not in HasherType.__members__:
+        raise ValueError(f"Unknown hasher_type {hasher_type}. Expected one of "
+                         f"{', '.join(HasherType.__members__)}")
+    hasher = HasherType.__members__[hasher_type]
+
     if isinstance(static_argnums, int):
         static_argnums = [static_argnums]
     elif static_argnums is not None and len(static_argnums) == 0:
@@ -384,7 +425,7 @@ def aot_function(
             fw_compiler_id,
             bw_compiler_id,
             num_tensor_args,
-            hasher_type,
+            hasher,
             *flat_args_for_cache,
         )
 
@@ -425,26 +466,30 @@ def aot_function(
                 out_spec.set(spec)
                 return flat_out
 
-            compiled_fn = create_aot_autograd_function(
+            compiled_function = create_aot_autograd_function(
                 flat_fn,
                 fw_compiler,
                 bw_compiler,
                 partition_fn,
                 decompositions,
                 grad_state=torch.is_grad_enabled(),
-            ).apply
-            cached_res = (compiled_fn, out_spec)
+            )
+            cached_res = (compiled_function.apply, out_spec)
+            out = compiled_function.apply(*flat_tensor_args)
 
-            # Save the compiled_fn in the cache
+            # The graphs get compiled on the first call. Save the compiled_fn in
+            # the cache, along with an estimate of the memory it holds.
             compile_cache.insert(
                 fn_id,
                 fw_compiler_id,
                 bw_compiler_id,
                 num_tensor_args,
-                hasher_type,
+                hasher,
                 cached_res,
                 *flat_args_for_cache,
+                nbytes=compiled_function.compiled_nbytes(),
             )
+            return out_spec.unflatten(out)
 
         cached_fn, out_spec = cached_res
         out = cached_fn(*flat_tensor_args)
@@ -456,7 +501,8 @@ def aot_function(
 def num_of_recompilations():
     """
     Returns the numbers of recompilations since the last time cache was cleared.
-    This is equivalent to the number of entries in the compilation cache.
+    This is equivalent to the number of entries in the compilation cache, so
+    entries evicted from a bounded cache are not counted.
     """
     global compile_cache
     if compile_cache is None:
@@ -464,6 +510,39 @@ def num_of_recompilations():
     return compile_cache.size()
 
 
+def set_compile_cache_capacity(max_entries: int = 0, max_bytes: int = 0):
+    """
+    Bounds the compilation cache by number of entries and by the estimated
+    bytes held by the compiled functions. Once full, the least recently used
+    entries (approximately) are evicted. 0 means unbounded, which is the
+    default.
+    """
+    global compile_cache
+    compile_cache_capacity["max_entries"] = max_entries
+    compile_cache_capacity["max_bytes"] = max_bytes
+    if compile_cache is not None:
+        compile_cache.set_capacity(max_entries, max_bytes)
+
+
+def compile_cache_stats():
+    """
+    Returns the hit, miss and eviction counts of the compilation cache, the
+    number of compiled functions not cached because they alone exceed max_bytes
+    ("rejected"), and its current number of entries and estimated bytes.
+    """
+    global compile_cache
+    if compile_cache is None:
+        return {
+            "hits": 0,
+            "misses": 0,
+            "evictions": 0,
+            "rejected": 0,
+            "size": 0,
+            "bytes": 0,
+        }
+    return compile_cache.stats()
+
+
 def clear_compile_cache():
     """
     Clears the compilation cache.
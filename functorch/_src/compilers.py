@@ -1,10 +1,15 @@
 import torch
 from functools import partial
-from typing import Iterable
+from typing import Callable, Iterable, Optional
 from .aot_autograd import aot_function, aot_module
 from .decompositions import decomposition_table
 from .partitioners import draw_graph, min_cut_rematerialization_partition
+import hashlib
+import json
+import os
+import tempfile
 import time
+import warnings
 
 
 def ts_compile(fx_g, _):
@@ -46,6 +51,135 @@ def ts_compile(fx_g, _):
     return f
 
 
+# Bump whenever the fingerprint or the layout of the cached files changes.
+_PERSISTENT_CACHE_VERSION = 1
+_PERSISTENT_CACHE_META = "functorch_compile_cache.json"
+
+
+def _default_persistent_cache_dir():
+    return os.environ.get(
+        "FUNCTORCH_COMPILE_CACHE_DIR",
+        os.path.join(os.path.expanduser("~"), ".cache", "functorch", "compile"),
+    )
+
+
+def _tensor_fingerprint(h, t):
+    h.update(f"{t.dtype}{tuple(t.shape)}{tuple(t.stride())}{t.device.type}{t.requires_grad}".encode())
+
+
+def _graph_fingerprint(compiler, fx_g, example_inputs):
+    """
+    Returns a fingerprint of :attr:`fx_g` that is stable across processes. It
+    covers the generated code, the values of the tensors owned by the graph,
+    the properties of the inputs the graph gets specialized for, and the
+    compiler, functorch cache and PyTorch versions.
+    """
+    h = hashlib.sha256()
+    h.update(f"{_PERSISTENT_CACHE_VERSION}:{torch.__version__}".encode())
+    h.update(f"{compiler.__module__}.{compiler.__qualname__}".encode())
+    h.update(fx_g.code.encode())
+    tensors = dict(fx_g.named_parameters())
+    tensors.update(fx_g.named_buffers())
+    tensors.update({k: v for k, v in vars(fx_g).items() if isinstance(v, torch.Tensor)})
+    for name in sorted(tensors):
+        t = tensors[name].detach().cpu().contiguous()
+        h.update(name.encode())
+        _tensor_fingerprint(h, t)
+        if t.dtype == torch.bfloat16:
+            t = t.view(torch.int16)
+        h.update(t.numpy().tobytes())
+    for inp in example_inputs:
+        if isinstance(inp, torch.Tensor):
+            _tensor_fingerprint(h, inp)
+        else:
+            h.update(repr(inp).encode())
+    return h.hexdigest()
+
+
+def _load_cached_module(path, fingerprint):
+    if not os.path.exists(path):
+        return None
+    extra_files = {_PERSISTENT_CACHE_META: ""}
+    try:
+        module = torch.jit.load(path, _extra_files=extra_files)
+        meta = json.loads(extra_files[_PERSISTENT_CACHE_META])
+    except Exception:
+        # Treat unreadable entries, e.g. written by another PyTorch version,
+        # as misses; they get overwritten.
+        return None
+    if meta.get("version") != _PERSISTENT_CACHE_VERSION or \
+            meta.get("torch_version") != torch.__version__ or \
+            meta.get("fingerprint") != fingerprint:
+        return None
+    return module
+
+
+def _save_cached_module(module, path, fingerprint):
+    meta = {
+        "version": _PERSISTENT_CACHE_VERSION,
+        "torch_version": torch.__version__,
+        "fingerprint": fingerprint,
+    }
+    directory = os.path.dirname(path)
+    os.makedirs(directory, exist_ok=True)
+    # Write to a temporary file first so that concurrent readers never see a
+    # partially written entry.
+    fd, tmp_path = tempfile.mkstemp(dir=directory, suffix=".tmp")
+    os.close(fd)
+    try:
+        torch.jit.save(module, tmp_path, _extra_files={_PERSISTENT_CACHE_META: json.dumps(meta)})
+        os.replace(tmp_path, path)
+    finally:
+        if os.path.exists(tmp_path):
+            os.remove(tmp_path)
+
+
+def persistent_compile(compiler: Callable = ts_compile, cache_dir: Optional[str] = None) -> Callable:
+    """
+    Wraps :attr:`compiler`, a compiler that returns TorchScript modules such
+    as :func:`ts_compile`, with a cache of the compiled modules on disk, so that
+    they are reused across processes. Entries are keyed by a fingerprint of
+    the Fx graph and of the inputs it gets compiled for. Results that are not
+    TorchScript modules are returned without being cached. The cache is best
+    effort: if saving an entry fails, e.g. on a read-only file system, a
+    warning is issued once and the compiled module is still returned.
+
+    Args:
+        compiler (Callable): The compiler to wrap. Default: :func:`ts_compile`
+        cache_dir (Optional[str]): The directory holding the cache. Defaults
+            to ``$FUNCTORCH_COMPILE_CACHE_DIR``, or else
+            ``~/.cache/functorch/compile``.
+
+    The returned compiler should be created once and reused, since
+    :func:`aot_function` caches compiled functions per compiler object.
+        >>> compiler = persistent_compile(ts_compile)
+        >>> aot_fn = aot_function(fn, compiler, compiler)
+    """
+    if cache_dir is None:
+        cache_dir = _default_persistent_cache_dir()
+    warned = False
+
+    def compile_fn(fx_g, example_inputs):
+        nonlocal warned
+        # Fingerprint before compiling, since compilers may mutate fx_g.
+        fingerprint = _graph_fingerprint(compiler, fx_g, example_inputs)
+        path = os.path.join(cache_dir, f"{fingerprint}.pt")
+        module = _load_cached_module(path, fingerprint)
+        if module is not None:
+            return module
+        compiled = compiler(fx_g, example_inputs)
+        if isinstance(compiled, torch.jit.ScriptModule):
+            try:
+                _save_cached_module(compiled, path, fingerprint)
+            except (OSError, RuntimeError) as e:
+                if not warned:
+                    warned = True
+                    warnings.warn(f"persistent_compile: not caching compiled modules in {cache_dir}: {e}")
+        return compiled
+
+    return compile_fn
+
+
 def tensorexpr_compile(fx_module, flat_args):
     """Compiles the given fx_module using TensorExpr Kernel"""
     inp_devices = set([i.device for i in flat_args if isinstance(i, torch.Tensor)])
@@ -235,14 +369,19 @@ def print_compile(fx_g, _):
     return fx_g
 
 
-def memory_efficient_fusion(fn, static_argnums=None):
+def memory_efficient_fusion(fn, static_argnums=None, persistent_cache_dir=None):
     """
     Recomputes the fwd pass in the bwd pass to perform memory efficient fusion.
-    Uses NVFuser as the backend compiler.
+    Uses NVFuser as the backend compiler. If :attr:`persistent_cache_dir` is
+    given, the compiled graphs are cached on disk there, see
+    :func:`persistent_compile`.
     """
+    compiler = ts_compile
+    if persistent_cache_dir is not None:
+        compiler = persistent_compile(ts_compile, persistent_cache_dir)
     config = {
-        'fw_compiler': ts_compile,
-        'bw_compiler': ts_compile,
+        'fw_compiler': compiler,
+        'bw_compiler': compiler,
         'partition_fn': min_cut_rematerialization_partition,
         'hasher_type': "StaticShapeHasher",
         'decompositions': default_decompositions,
@@ -1,18 +1,25 @@
+import concurrent.futures
 import copy
 import functools
 import inspect
 import itertools
-from typing import Callable, List, Union, Tuple, Optional
+import json
+from typing import Any, Callable, Dict, Iterable, List, Union, Tuple, Optional, Sequence
 import operator
 
 import torch
 from torch import fx
 from torch._C import _te  # type: ignore[attr-defined]
-from functorch._C import PointwiseOperatorCompileCache, PointwiseOperatorCompileResult
+from functorch._C import (
+    PointwiseArgKind,
+    PointwiseOperatorCompileCache,
+    PointwiseOperatorCompileResult,
+)
 
 FOLD_ALIASES = True
 _SHAPE_TYPES = {"one", "other"}
 _STRIDE_TYPES = {"zero", "one", "contiguous", "transposed_contiguous", "as_arg"}
+_REDUCTIONS = {"sum", "mean", "amax", "amin"}
 
 
 def _identity(x):
@@ -82,6 +89,72 @@ def _num_args(fn: Callable):
     return len(inspect.signature(fn).parameters)
 
 
+def _param_options(param: inspect.Parameter, specialize: Sequence[str]):
+    """
+    Possible (signature type, PointwiseArgKind) pairs of a parameter of a
+    pointwise fn: float and int annotated parameters are scalars, the rest
+    tensors.  A Union annotation gives one option per type.
+    """
+    annotation = param.annotation
+    if getattr(annotation, "__origin__", None) is Union:
+        types = annotation.__args__
+    else:
+        types = (annotation,)
+    options = []
+    for t in types:
+        if t is float:
+            kind = (
+                PointwiseArgKind.SpecializedDouble
+                if param.name in specialize
+                else PointwiseArgKind.Double
+            )
+            options.append(("double", kind))
+        elif t is int:
+            kind = (
+                PointwiseArgKind.SpecializedInt
+                if param.name in specialize
+                else PointwiseArgKind.Int
+            )
+            options.append(("int64_t", kind))
+        else:
+            options.append(("Tensor", PointwiseArgKind.Tensor))
+    return options
+
+
+def _overloads(fn: Callable, specialize: Sequence[str]):
+    """
+    Compute the overloads of a pointwise fn, one for each combination of
+    parameter options that takes at least one tensor.  Returns the signature
+    arguments and the PointwiseArgKinds of each overload.
+    """
+    params = list(inspect.signature(fn).parameters.values())
+    signature_args = []
+    arg_kinds = []
+    for options in itertools.product(*[_param_options(p, specialize) for p in params]):
+        kinds = [kind for _, kind in options]
+        if PointwiseArgKind.Tensor not in kinds:
+            continue
+        args = []
+        for (sig_type, kind), param in zip(options, params):
+            arg = f"{sig_type} {param.name}"
+            if kind != PointwiseArgKind.Tensor and param.default is not param.empty:
+                arg += f"={param.default}"
+            args.append(arg)
+        signature_args.append(args)
+        arg_kinds.append(kinds)
+    return signature_args, arg_kinds
+
+
+def _spec_summary(spec: List):
+    """Describe the specialization keys of a kernel, for profiler traces"""
+    return ", ".join(
+        f"{'out ' if s.out else ''}{s.dtype} {s.device} "
+        f"shape=[{','.join(s.shape)}] stride=[{','.join(s.stride)}] "
+        f"alias_group={s.alias_group}"
+        for s in spec
+    )
+
+
 def _combine_dtype(a: torch.dtype, b: torch.dtype):
     if a == b:
         return a
@@ -135,6 +208,27 @@ def _create_constant(value: Union[int, float], dtype: torch.dtype):
     )
 
 
+def _reduce_init(reduce: str, dtype: torch.dtype):
+    """Initial value of the accumulator of a reduction"""
+    if reduce in ("sum", "mean"):
+        return _create_constant(0, dtype)
+    if dtype.is_floating_point:
+        return _create_constant(float("-inf" if reduce == "amax" else "inf"), dtype)
+    info = torch.iinfo(dtype)
+    return _te.Cast.make(
+        dtype, _te.ExprHandle.long(info.min if reduce == "amax" else info.max)
+    )
+
+
+def _reduce_update(reduce: str, acc, val):
+    """New value of the accumulator of a reduction, after reducing val"""
+    if reduce in ("sum", "mean"):
+        return acc + val
+    better = val > acc if reduce == "amax" else val < acc
+    # NaNs compare false, check for them to propagate NaNs like torch.amax
+    return _te.ifThenElse(val != val, val, _te.ifThenElse(better, val, acc))
+
+
 class PointwiseCompiler(object):
     def __init__(
         self,
@@ -143,12 +237,31 @@ class PointwiseCompiler(object):
         pointwise_fn: Callable,
         spec: List,
         result: PointwiseOperatorCompileResult,
+        num_outputs: int = 1,
+        arg_kinds: Optional[List] = None,
+        specialized: Tuple = (),
+        reduce: Optional[str] = None,
     ):
         self.name = name
         self.module_name = module_name
         self.pointwise_fn = pointwise_fn
         self.spec = spec
         self.result = result
+        self.num_outputs = num_outputs
+        self.arg_kinds = arg_kinds or [PointwiseArgKind.Tensor] * _num_args(
+            pointwise_fn
+        )
+        self.specialized = specialized
+        # Reduction over the last dim, if any
+        self.reduce = reduce
+        # Scalars passed to the kernel as parameters, after the shapes
+        self.scalar_args = [
+            _te.VarHandle(
+                torch.float64 if kind == PointwiseArgKind.Double else torch.int64
+            )
+            for kind in self.arg_kinds
+            if kind in (PointwiseArgKind.Double, PointwiseArgKind.Int)
+        ]
         self.ndim = max(x.ndim for x in spec)
         self.shapes = [["one"] * (self.ndim - x.ndim) + x.shape for x in spec]
         self.strides = [["zero"] * (self.ndim - x.ndim) + x.stride for x in spec]
@@ -192,6 +305,7 @@ class PointwiseCompiler(object):
         (layout,) = list(set(x.layout for x in spec))
         assert layout == torch.strided, "TODO: support other layouts"
         assert [x.out for x in spec[:-1]] == [False] * (len(spec) - 1)
+        assert self.num_outputs == 1 or not spec[-1].out, "TODO: support multiple out="
         assert all(
             shape_type in _SHAPE_TYPES for shape_type in itertools.chain(*self.shapes)
         )
@@ -199,32 +313,84 @@ class PointwiseCompiler(object):
             stride_type in _STRIDE_TYPES
             for stride_type in itertools.chain(*self.strides)
         )
-
-    def make_backwards(self, index: int):
+        if self.reduce:
+            assert self.reduce in _REDUCTIONS, f"unknown reduction {self.reduce}"
+            assert self.ndim > 0, "reductions need a dim to reduce over"
+            assert self.num_outputs == 1, "TODO: support multiple reduction outputs"
+            assert not spec[-1].out, "TODO: support out= for reductions"
+            assert (
+                self.reduce != "mean" or self.dtype.is_floating_point
+            ), "mean needs a floating point dtype"
+            assert self.dtype != torch.bool or self.reduce == "sum"
+
+    def reduction_dtypes(self):
+        """
+        The dtypes a reduction accumulates in and returns.  Like torch.sum,
+        sums of integers are int64, and half precision floats accumulate in float.
         """
-        Compute the derivative of self.pointwise_fn with respect to input number index
+        if self.dtype in (torch.float16, torch.bfloat16) and self.reduce in (
+            "sum",
+            "mean",
+        ):
+            return torch.float32, self.dtype
+        if not self.dtype.is_floating_point and self.reduce == "sum":
+            return torch.int64, torch.int64
+        return self.dtype, self.dtype
+
+    def make_backwards(self, indices: List[int]):
+        """
+        Compute the derivatives of self.pointwise_fn with respect to the tensor
+        inputs numbered indices, as a single kernel with one output per index.
+        Returns the tensor inputs that kernel reads (before the grad of the
+        output) and the kernel.  Specialized scalars are compiled into the kernel
+        as constants; the other scalars are parameters of the kernel, after the
+        grad, in the same order as in the forward call.
         """
         # TODO(jansel): implement this without sympy
         from sympy import symbols, diff  # type: ignore[import]
 
-        vars = symbols([f"v{i}" for i in range(1 + _num_args(self.pointwise_fn))])
-        backwards_expr = (
-            diff(self.pointwise_fn(*vars[:-1]), vars[index]) * vars[-1]
-        )  # chain rule
-        return _source_to_pointwise_operator(
-            f"lambda {','.join(map(str, vars))}: {backwards_expr}",
-            name=f"{self.name}.backwards{index}",
+        nargs = _num_args(self.pointwise_fn)
+        vars = symbols([f"v{i}" for i in range(1 + nargs)])
+        specialized = iter(self.specialized)
+        args = []
+        tensor_vars = []
+        scalar_params = []
+        for var, kind in zip(vars, self.arg_kinds):
+            if kind == PointwiseArgKind.Tensor:
+                args.append(var)
+                tensor_vars.append(var)
+            elif kind in (PointwiseArgKind.Double, PointwiseArgKind.Int):
+                args.append(var)
+                annotation = "float" if kind == PointwiseArgKind.Double else "int"
+                scalar_params.append(f"{var}: {annotation}")
+            else:
+                args.append(next(specialized))
+        forward_expr = self.pointwise_fn(*args)
+        backwards_exprs = [
+            diff(forward_expr, tensor_vars[index]) * vars[-1] for index in indices
+        ]  # chain rule
+        used = set().union(*(expr.free_symbols for expr in backwards_exprs))
+        saved = [i for i, var in enumerate(tensor_vars) if var in used]
+        params = [str(tensor_vars[i]) for i in saved] + [str(vars[-1])] + scalar_params
+        return saved, _source_to_pointwise_operator(
+            f"def backwards({', '.join(params)}):\n"
+            f"    return ({', '.join(map(str, backwards_exprs))},)\n",
+            name=f"{self.name}.backwards",
             module_name=self.module_name,
+            num_outputs=len(indices),
         )
 
     def handle_autograd(self):
         cnt = sum(int(x.requires_grad) for x in self.spec)
         if cnt == 0:
             return
+        assert not self.reduce, "TODO: support backwards of reductions"
         assert all(
             x.alias_group == 0 for x in self.spec
         ), "TODO: support aliased backwards"
+        assert self.num_outputs == 1, "TODO: support backwards of multiple outputs"
 
+        grad_inputs = []
         for i, spec in enumerate(self.spec):
             if spec.requires_grad:
                 assert spec.alias_group == 0, "TODO: support aliased backwards"
@@ -234,7 +400,12 @@ class PointwiseCompiler(object):
                     assert (
                         len(shape_types) == 1
                     ), "TODO: support backwards for broadcasting"
-                self.result.set_backwards(i, self.make_backwards(i))
+                grad_inputs.append(i)
+        # One kernel computes the grads of all inputs in a single pass
+        saved_inputs, backwards = self.make_backwards(grad_inputs)
+        self.result.set_backwards(
+            grad_inputs, saved_inputs, backwards, len(self.scalar_args)
+        )
 
     def compute_broadcasts_and_size_checks(self):
         ndim = self.ndim
@@ -332,23 +503,54 @@ class PointwiseCompiler(object):
             result = result + c * s
         return result
 
+    def reduction_body(self, buf, index, val, dtype: torch.dtype):
+        """Reduce val over the last dim into buf[index], accumulating in dtype"""
+        if isinstance(val, (int, float)):
+            val = _create_constant(val, dtype)
+        update = buf.store(
+            index,
+            _reduce_update(self.reduce, buf.load(index), _te.Cast.make(dtype, val)),
+        )
+        stmts = [
+            buf.store(index, _reduce_init(self.reduce, dtype)),
+            _te.For.make(self.iter_vars[-1], _zero(), self.shape_vars[-1], update),
+        ]
+        if self.reduce == "mean":
+            count = _te.Cast.make(dtype, self.shape_vars[-1])
+            stmts.append(buf.store(index, buf.load(index) / count))
+        return _te.Block(stmts)
+
     def compute_code(self):
         bufs = [_te.BufHandle(s.dtype) for s in self.spec]
+        # Reduction outputs drop the reduced last dim, which is iterated over
+        # innermost
+        out_ndim = self.ndim - 1 if self.reduce else self.ndim
+        out_order = [d for d in self.output_order if d < out_ndim]
+        if self.reduce:
+            out_dtype, result_dtype = self.reduction_dtypes()
+        else:
+            out_dtype = result_dtype = self.dtype
         if not self.spec[-1].out:
             options_from = [
                 i for i in range(len(self.spec)) if self.spec[i].dtype == self.dtype
             ][0]
-            self.result.add_allocated_output(options_from, self.output_order)
-            bufs.append(_te.BufHandle(self.dtype))
-
-            self.shapes.append(list(self.shape_vars))
-            output_strides = [None] * self.ndim
+            output_strides = [None] * out_ndim
             next_stride = _one()
-            for i in self.output_order:
+            for i in out_order:
                 output_strides[i] = next_stride
                 next_stride *= self.shape_vars[i]
             assert all((x is not None) for x in output_strides)
-            self.strides.append(output_strides)
+
+            for _ in range(self.num_outputs):
+                self.result.add_allocated_output(
+                    options_from,
+                    out_order,
+                    dtype=out_dtype if out_dtype != self.dtype else None,
+                    result_dtype=result_dtype if result_dtype != out_dtype else None,
+                )
+                bufs.append(_te.BufHandle(out_dtype))
+                self.shapes.append(list(self.shape_vars[:out_ndim]))
+                self.strides.append(list(output_strides))
 
         bufs_args = list(bufs)
 
@@ -361,25 +563,50 @@ class PointwiseCompiler(object):
                 # BufHandle in buf_args is now ignored
                 bufs[i] = bufs[aliases[s.alias_group]]
 
-        input_bufs = bufs[:-1]
-        input_strides = self.strides[:-1]
-        output_bufs = bufs[-1:]
-        output_strides = self.strides[-1:]
+        input_bufs = bufs[: -self.num_outputs]
+        input_strides = self.strides[: -self.num_outputs]
+        output_bufs = bufs[-self.num_outputs :]
+        output_strides = self.strides[-self.num_outputs :]
 
-        inputs = [
-            _te.Cast.make(self.dtype, buf.load(self.indexing(stride)))
-            for buf, stride in zip(input_bufs, input_strides)
-        ]
-        val = _fx_to_expr(self.pointwise_fn, self.dtype)(*inputs)
-        out = _te.Block(
+        tensor_inputs = iter(
             [
-                buf.store(self.indexing(stride), val)
-                for buf, stride in zip(output_bufs, output_strides)
+                _te.Cast.make(self.dtype, buf.load(self.indexing(stride)))
+                for buf, stride in zip(input_bufs, input_strides)
             ]
         )
+        scalar_args = iter(self.scalar_args)
+        specialized = iter(self.specialized)
+        inputs = []
+        for kind in self.arg_kinds:
+            if kind == PointwiseArgKind.Tensor:
+                inputs.append(next(tensor_inputs))
+            elif kind in (PointwiseArgKind.Double, PointwiseArgKind.Int):
+                inputs.append(_te.Cast.make(self.dtype, next(scalar_args)))
+            else:
+                inputs.append(_create_constant(next(specialized), self.dtype))
+        vals = _fx_to_expr(self.pointwise_fn, self.dtype)(*inputs)
+        if not isinstance(vals, tuple):
+            vals = (vals,)
+        assert len(vals) == self.num_outputs
+        if self.reduce:
+            out = self.reduction_body(
+                output_bufs[0], self.indexing(output_strides[0]), vals[0], out_dtype
+            )
+        else:
+            out = _te.Block(
+                [
+                    buf.store(
+                        self.indexing(stride),
+                        _create_constant(val, self.dtype)
+                        if isinstance(val, (int, float))
+                        else val,
+                    )
+                    for buf, stride, val in zip(output_bufs, output_strides, vals)
+                ]
+            )
 
         loops: List[_te.For] = []
-        for i in self.output_order:
+        for i in out_order:
             var = self.iter_vars[i]
             size = self.shape_vars[i]
             out = _te.For.make(var, _zero(), size, out)
@@ -401,7 +628,7 @@ class PointwiseCompiler(object):
         cg = _te.construct_codegen(
             self.compile_mode,
             loopnest.simplify(),
-            bufs_args + self.stride_args + self.shape_args,
+            bufs_args + self.stride_args + self.shape_args + self.scalar_args,
         )
         self.result.set_code(cg)
 
@@ -414,20 +641,152 @@ class PointwiseCompiler(object):
         self.compute_code()
 
 
+_precompile_executor: Optional[concurrent.futures.ThreadPoolExecutor] = None
+
+# Version of the files written by save_cached_kernels()
+_CACHED_KERNELS_VERSION = 1
+
+
+def _get_precompile_executor():
+    global _precompile_executor
+    if _precompile_executor is None:
+        _precompile_executor = concurrent.futures.ThreadPoolExecutor(
+            max_workers=1, thread_name_prefix="pointwise_precompile"
+        )
+    return _precompile_executor
+
+
 class _PointwiseOperatorCompileCache(PointwiseOperatorCompileCache):
-    pass
+    def precompile(self, examples: Iterable[Tuple], background: bool = False):
+        """
+        Compile the kernels for a set of example calls ahead of time, so the
+        first real call with the same dtypes/devices/layouts/etc. hits the
+        cache.  Each example is a tuple of args, as passed to the operator, or
+        an (args, kwargs) pair.  Only the properties the kernels specialize on
+        matter, so small tensors stand in for large ones with the same layout:
+
+            add.precompile([(torch.empty(2, 2), torch.empty(2))])
+
+        With background=True, compiles on a background thread and returns a
+        Future.  Kernels are published to the cache as they are compiled,
+        which is safe while other threads call the operator.
+        """
+        return self._compile_all(self._precompile_example, list(examples), background)
+
+    def cached_kernels(self) -> List[dict]:
+        """
+        List the kernels in the cache, as a dict per kernel with its
+        specialization keys as passed to the compiler ("spec"), the number of
+        calls that found it in the cache ("hits"), the seconds it took to
+        compile ("compile_time"), and the serialized key along with fields
+        locating the cache it is in.  The first calls, and then one call in
+        1024, release the GIL and time the kernel and the GIL handoff, to
+        decide whether other calls release it: "timed_calls", "ns_per_element"
+        and "gil_release_ns", the fastest handoff.
+        """
+        return self._cached_kernels()
+
+    def save_cached_kernels(self, path: str):
+        """
+        Save the keys of the cached kernels and their stats to a json file,
+        which load_cached_kernels() takes to compile them again, e.g. when
+        warming up a later run.  Keys depend on the torch build, so files only
+        load with the same version of torch.
+        """
+        kernels = []
+        for record in self._cached_kernels():
+            record["spec"] = _spec_summary(record["spec"])
+            record["key"] = record["key"].hex()
+            if "specialized" in record:
+                record["specialized"] = record["specialized"].hex()
+            kernels.append(record)
+        with open(path, "w") as f:
+            json.dump(
+                {
+                    "version": _CACHED_KERNELS_VERSION,
+                    "torch_version": torch.__version__,
+                    "name": self.__name__,
+                    "kernels": kernels,
+                },
+                f,
+                indent=1,
+            )
+
+    def load_cached_kernels(self, path: str, background: bool = False):
+        """
+        Compile the kernels saved by save_cached_kernels(), unless cached.
+        With background=True, compiles on a background thread and returns a
+        Future, like precompile().
+        """
+        with open(path) as f:
+            data = json.load(f)
+        if data.get("version") != _CACHED_KERNELS_VERSION:
+            raise ValueError(f"{path}: unsupported version {data.get('version')}")
+        if data["torch_version"] != torch.__version__:
+            raise ValueError(
+                f"{path}: saved with torch {data['torch_version']}, "
+                f"keys don't carry over to torch {torch.__version__}"
+            )
+        if data["name"] != self.__name__:
+            raise ValueError(f"{path}: saved for operator {data['name']}")
+        records = []
+        for record in data["kernels"]:
+            record["key"] = bytes.fromhex(record["key"])
+            if "specialized" in record:
+                record["specialized"] = bytes.fromhex(record["specialized"])
+            records.append(record)
+        return self._compile_all(self._precompile_record, records, background)
+
+    def _precompile_example(self, example):
+        if len(example) == 2 and isinstance(example[1], dict):
+            args, kwargs = example
+        else:
+            args, kwargs = example, {}
+        self._precompile(*args, **kwargs)
+
+    def _compile_all(self, compile_one: Callable, items: List, background: bool):
+        if background:
+            # Keys specialize on requires_grad only when grad mode is enabled,
+            # and both modes are thread local, so compile under the caller's.
+            grad_enabled = torch.is_grad_enabled()
+            inference_mode = torch.is_inference_mode_enabled()
+
+            def compile_all():
+                with torch.set_grad_enabled(grad_enabled), torch.inference_mode(
+                    inference_mode
+                ):
+                    self._compile_all(compile_one, items, False)
+
+            return _get_precompile_executor().submit(compile_all)
+        for item in items:
+            compile_one(item)
 
 
 @functools.lru_cache(None)
 def _source_to_pointwise_operator(
-    fn_str: str, name: Optional[str] = None, module_name: Optional[str] = None
+    fn_str: str,
+    name: Optional[str] = None,
+    module_name: Optional[str] = None,
+    num_outputs: int = 1,
 ):
-    """Used when creating backwards() methods"""
-    return pointwise_operator(eval(fn_str), name=name, module_name=module_name)
+    """Used when creating backwards() methods, fn_str defines a function backwards"""
+    scope: Dict[str, Any] = {}
+    exec(fn_str, globals(), scope)
+    return pointwise_operator(
+        scope["backwards"],
+        name=name,
+        module_name=module_name,
+        num_outputs=num_outputs,
+    )
 
 
 def pointwise_operator(
-    fn: Callable, name: Optional[str] = None, module_name: Optional[str] = None
+    fn: Callable,
+    name: Optional[str] = None,
+    module_name: Optional[str] = None,
+    num_outputs: int = 1,
+    specialize: Sequence[str] = (),
+    reduce: Optional[str] = None,
 ):
     """
     Decorator to create a new pointwise operator.  The operator will be
@@ -436,18 +795,77 @@ def pointwise_operator(
         @pointwise_operator
         def add(a, b):
             return a + b
+
+    Parameters annotated as float or int take python numbers, which are passed
+    to the kernel as parameters.  They are not specialized on, unless named in
+    specialize, in which case a kernel is compiled for every value.  A
+    parameter annotated Union[torch.Tensor, float] creates an overload for
+    either type.
+
+        @pointwise_operator
+        def axpy(a, x, y: float = 1.0):
+            return a * x + y
+
+    With num_outputs > 1, fn returns a tuple and the operator computes all
+    outputs in one kernel; out= is not supported then.
+
+    With reduce set to "sum", "mean", "amax" or "amin", the operator reduces
+    the result of fn over the last dim, in the same kernel; out= is not
+    supported then either.
+
+        @functools.partial(pointwise_operator, reduce="sum")
+        def sum_exp(x, max):
+            return torch.exp(x - max)
     """
+    if reduce is not None and reduce not in _REDUCTIONS:
+        raise ValueError(f"unknown reduction {reduce}")
     name = name or fn.__name__
     module_name = module_name or fn.__module__
-    args = [f"Tensor {name}" for name in inspect.signature(fn).parameters.keys()]
-    signature = f"{name}({', '.join(args)}, *, Tensor? out=None)"
-
-    def compile_fn(spec, result):
-        return PointwiseCompiler(str(name), str(module_name), fn, spec, result)
+    signature_args, arg_kinds = _overloads(fn, specialize)
+    if num_outputs == 1 and reduce is None:
+        signatures = [
+            f"{name}({', '.join(args)}, *, Tensor? out=None)" for args in signature_args
+        ]
+    else:
+        signatures = [f"{name}({', '.join(args)})" for args in signature_args]
+
+    def compile_fn(spec, result, overload=0, specialized=()):
+        # Shows up in profiler traces nested under the kernel call, so
+        # recompiles are visible.
+        summary = _spec_summary(spec)
+        # Also recorded on the events of calls to the kernel
+        result.set_spec_summary(summary)
+        with torch.autograd.profiler.record_function(f"{name}::compile", summary):
+            return PointwiseCompiler(
+                str(name),
+                str(module_name),
+                fn,
+                spec,
+                result,
+                num_outputs,
+                arg_kinds[overload],
+                specialized,
+                reduce,
+            )
+
+    if len(arg_kinds) == 1 and all(
+        kind == PointwiseArgKind.Tensor for kind in arg_kinds[0]
+    ):
+        # Only tensors, use the faster cache without overloads
+        cache_arg_kinds = []
+    else:
+        cache_arg_kinds = arg_kinds
 
     # This items are needed to support FX tracing
     rv = _PointwiseOperatorCompileCache(
-        name, module_name, [signature], compile_fn, _num_args(fn)
+        name,
+        module_name,
+        signatures,
+        compile_fn,
+        _num_args(fn),
+        num_outputs,
+        cache_arg_kinds,
+        1 if reduce else 0,
     )
     rv.__name__ = name
     rv.__qualname__ = name
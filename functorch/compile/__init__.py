@@ -9,9 +9,12 @@ from .._src.aot_autograd import (
     compiled_module,
     num_of_recompilations,
     clear_compile_cache,
+    set_compile_cache_capacity,
+    compile_cache_stats,
 )
 from .._src.compilers import (
     ts_compile,
+    persistent_compile,
     tvm_compile,
     draw_graph_compile,
     nop,
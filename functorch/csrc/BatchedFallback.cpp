@@ -9,14 +9,22 @@
 #include <functorch/csrc/Constants.h>
 #include <functorch/csrc/TensorWrapper.h>
 #include <functorch/csrc/DynamicLayer.h>
+#include <functorch/csrc/BatchRulesHelper.h>
 
 #include <ATen/Context.h>
 #include <ATen/MatrixRef.h>
+#include <ATen/MemoryOverlap.h>
+#include <ATen/Parallel.h>
+#include <ATen/ThreadLocalState.h>
 #include <ATen/core/dispatch/Dispatcher.h>
 #include <c10/util/accumulate.h>
 #include <c10/util/llvmMathExtras.h>
 #include <c10/util/irange.h>
 
+#include <chrono>
+#include <mutex>
+#include <sstream>
+
 namespace at {
 namespace functorch {
 
@@ -40,6 +48,131 @@ void setVmapFallbackEnabled(bool enabled) {
   kVmapFallbackEnabled = enabled;
 }
 
+bool kVmapParallelFallbackEnabled = false;
+
+bool isVmapParallelFallbackEnabled() {
+  return kVmapParallelFallbackEnabled;
+}
+
+void setVmapParallelFallbackEnabled(bool enabled) {
+  kVmapParallelFallbackEnabled = enabled;
+}
+
+bool kVmapBatchedCallFallbackEnabled = true;
+
+bool isVmapBatchedCallFallbackEnabled() {
+  return kVmapBatchedCallFallbackEnabled;
+}
+
+void setVmapBatchedCallFallbackEnabled(bool enabled) {
+  kVmapBatchedCallFallbackEnabled = enabled;
+}
+
+// NOTE: [Fallback profiler]
+// When profiling is enabled, every call into the fallbacks records, keyed by
+// operator name: the number of calls, the number of times `op` was invoked
+// on a slice (one for a batched call), the wall time spent in the fallback and
+// the number of bytes of batched outputs it had to materialize. This lets us
+// rank missing batching rules by what they actually cost. It also counts the
+// calls that ran their slices in parallel (see NOTE: [Parallel fallback]).
+bool kVmapFallbackProfilingEnabled = false;
+
+bool isVmapFallbackProfilingEnabled() {
+  return kVmapFallbackProfilingEnabled;
+}
+
+void setVmapFallbackProfilingEnabled(bool enabled) {
+  kVmapFallbackProfilingEnabled = enabled;
+}
+
+static std::mutex& fallbackProfileMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+static std::map<std::string, VmapFallbackStats>& fallbackProfile() {
+  static std::map<std::string, VmapFallbackStats> profile;
+  return profile;
+}
+
+void resetVmapFallbackProfile() {
+  std::lock_guard<std::mutex> guard(fallbackProfileMutex());
+  fallbackProfile().clear();
+}
+
+std::map<std::string, VmapFallbackStats> getVmapFallbackProfile() {
+  std::lock_guard<std::mutex> guard(fallbackProfileMutex());
+  return fallbackProfile();
+}
+
+std::string dumpVmapFallbackProfileJson() {
+  std::ostringstream ss;
+  ss << "{";
+  bool first = true;
+  for (const auto& entry : getVmapFallbackProfile()) {
+    if (!first) {
+      ss << ", ";
+    }
+    first = false;
+    // Operator names only contain identifier characters, '::' and '.'.
+    ss << "\"" << entry.first << "\": {"
+       << "\"num_calls\": " << entry.second.num_calls << ", "
+       << "\"num_slices\": " << entry.second.num_slices << ", "
+       << "\"total_time_ns\": " << entry.second.total_time_ns << ", "
+       << "\"bytes_materialized\": " << entry.second.bytes_materialized << ", "
+       << "\"num_parallel_calls\": " << entry.second.num_parallel_calls << "}";
+  }
+  ss << "}";
+  return ss.str();
+}
+
+// Records one call into a fallback when it goes out of scope.
+class FallbackProfileRecorder {
+ public:
+  explicit FallbackProfileRecorder(const c10::FunctionSchema& schema)
+    : schema_(schema), enabled_(isVmapFallbackProfilingEnabled()) {
+    if (enabled_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~FallbackProfileRecorder() {
+    if (!enabled_) {
+      return;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start_;
+    std::lock_guard<std::mutex> guard(fallbackProfileMutex());
+    auto& stats = fallbackProfile()[toString(schema_.operator_name())];
+    stats.num_calls++;
+    stats.num_slices += num_slices_;
+    stats.total_time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    stats.bytes_materialized += bytes_materialized_;
+    stats.num_parallel_calls += ran_in_parallel_ ? 1 : 0;
+  }
+
+  void setNumSlices(int64_t num_slices) {
+    num_slices_ = num_slices;
+  }
+
+  void setRanInParallel() {
+    ran_in_parallel_ = true;
+  }
+
+  void addBytesMaterialized(const Tensor& tensor) {
+    if (enabled_ && tensor.defined()) {
+      bytes_materialized_ += tensor.nbytes();
+    }
+  }
+
+ private:
+  const c10::FunctionSchema& schema_;
+  bool enabled_;
+  std::chrono::steady_clock::time_point start_;
+  int64_t num_slices_ = 0;
+  int64_t bytes_materialized_ = 0;
+  bool ran_in_parallel_ = false;
+};
+
 // Given a linear index, return the actual index.
 // Example: Given linear_idx = 3, sizes = [5, 2], we would return [1, 0]
 static at::SmallVector<indexing::TensorIndex,kVmapStaticDimVecSize>
@@ -56,6 +189,145 @@ computeIndex(int64_t linear_idx, IntArrayRef sizes) {
   return result;
 }
 
+// Pushes the arguments for the slice at `index` onto `stack`. The arguments
+// are read from `args_stack`, starting at `arguments_begin`; BatchedTensor
+// arguments (at `batched_tensor_inputs_position`) get replaced by the
+// corresponding slice of their physical view.
+static void pushSlicedArguments(
+    torch::jit::Stack* stack,
+    const torch::jit::Stack& args_stack,
+    size_t arguments_begin,
+    size_t num_arguments,
+    const VmapDimVector& batched_tensor_inputs_position,
+    const VmapPhysicalViewVec& input_physical_views,
+    ArrayRef<indexing::TensorIndex> index) {
+  auto batched_tensor_inputs_pos_iter = batched_tensor_inputs_position.begin();
+  auto input_physical_views_iter = input_physical_views.begin();
+  for (const auto arg_idx : c10::irange(0, num_arguments)) {
+    // We assume that torch::jit::Stack is backed by vector<IValue> for
+    // simplicity. When that is not the case, this code should be updated.
+    const auto& argument = args_stack[arguments_begin + arg_idx];
+    if (batched_tensor_inputs_pos_iter == batched_tensor_inputs_position.end()
+        || (int64_t)arg_idx != *batched_tensor_inputs_pos_iter) {
+      // argument isn't a BatchedTensor
+      torch::jit::push(stack, argument);
+      continue;
+    }
+    // argument is a BatchedTensor
+    TORCH_INTERNAL_ASSERT(input_physical_views_iter != input_physical_views.end());
+    const auto& physical_view_for_argument = *input_physical_views_iter;
+    torch::jit::push(stack, physical_view_for_argument.tensor().index(index));
+    batched_tensor_inputs_pos_iter++;
+    input_physical_views_iter++;
+  }
+}
+
+// NOTE: [Parallel fallback]
+// Slices are independent of each other, so when opted in via
+// setVmapParallelFallbackEnabled the fallback runs them through
+// at::parallel_for. Each worker gets its own stack and runs under a copy of
+// the calling thread's ThreadLocalState, which carries the functorch TLS (the
+// DynamicLayer stack) and the local dispatch key set. Nested parallel_for
+// calls inside `op` run serially, so we respect the intra-op thread pool.
+//
+// We only do this for plain dense CPU tensors that don't require grad (no
+// Python or functorch wrappers below us that may need the GIL or global
+// transform state, and no autograd metadata shared between slices) and for
+// operators that don't consume a Generator, whose results would otherwise
+// depend on the order the slices ran in. In-place operators additionally need
+// `self` to share no memory with itself across slices or with any other
+// argument, since a slice could otherwise read what another one is writing.
+static bool isParallelFallbackSafeTensor(const Tensor& tensor) {
+  constexpr DispatchKeySet allowed_keys({
+    DispatchKey::CPU,
+    DispatchKey::AutogradCPU,
+    DispatchKey::ADInplaceOrView,
+    DispatchKey::Conjugate,
+    DispatchKey::Negative,
+  });
+  if (!tensor.defined()) {
+    return true;
+  }
+  return (tensor.key_set() - allowed_keys).empty() && !tensor.requires_grad();
+}
+
+static bool canRunSlicesInParallel(
+    const c10::FunctionSchema& schema,
+    const torch::jit::Stack& args_stack,
+    size_t arguments_begin,
+    const VmapPhysicalViewVec& input_physical_views,
+    int64_t num_batches) {
+  if (!isVmapParallelFallbackEnabled() || num_batches < 2 ||
+      at::get_num_threads() <= 1 || at::in_parallel_region()) {
+    return false;
+  }
+  const auto generator_type = OptionalType::create(GeneratorType::get());
+  for (const auto& argument : schema.arguments()) {
+    if (argument.type()->isSubtypeOf(generator_type)) {
+      return false;
+    }
+  }
+  for (const auto& physical_view : input_physical_views) {
+    if (!isParallelFallbackSafeTensor(physical_view.tensor())) {
+      return false;
+    }
+  }
+  for (const auto arg_idx : c10::irange(0, schema.arguments().size())) {
+    const auto& ivalue = args_stack[arguments_begin + arg_idx];
+    if (ivalue.isTensor() && !isBatchedTensor(ivalue.toTensor()) &&
+        !isParallelFallbackSafeTensor(ivalue.toTensor())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether any argument other than `self` (the first batched argument of an
+// in-place operator) may share memory with the physical `self`. Slices of
+// `self` are written while the other arguments are read, so running them in
+// parallel would race. Lists of Tensors are conservatively assumed to overlap.
+static bool anyArgumentMayOverlapSelf(
+    const torch::jit::Stack& args_stack,
+    size_t arguments_begin,
+    size_t num_arguments,
+    const VmapPhysicalViewVec& input_physical_views) {
+  const auto& self_physical = input_physical_views.front().tensor();
+  const auto overlaps = [&](const Tensor& tensor) {
+    return tensor.defined() &&
+        at::get_overlap_status(self_physical, tensor) != MemOverlapStatus::NO;
+  };
+  for (const auto view_idx : c10::irange(1, input_physical_views.size())) {
+    if (overlaps(input_physical_views[view_idx].tensor())) {
+      return true;
+    }
+  }
+  for (const auto arg_idx : c10::irange(1, num_arguments)) {
+    const auto& ivalue = args_stack[arguments_begin + arg_idx];
+    if (ivalue.isTensorList() || ivalue.isList()) {
+      return true;
+    }
+    if (ivalue.isTensor() && !isBatchedTensor(ivalue.toTensor()) &&
+        overlaps(ivalue.toTensor())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Calls `fn(stack, linear_idx)` for every linear_idx in [begin, end) using
+// at::parallel_for. See NOTE: [Parallel fallback]
+template <typename F>
+static void parallelForSlices(int64_t begin, int64_t end, const F& fn) {
+  const at::ThreadLocalState tls_state;
+  at::parallel_for(begin, end, /*grain_size=*/1, [&](int64_t chunk_begin, int64_t chunk_end) {
+    at::ThreadLocalStateGuard tls_guard(tls_state);
+    torch::jit::Stack slice_stack;
+    for (int64_t linear_idx = chunk_begin; linear_idx < chunk_end; ++linear_idx) {
+      fn(&slice_stack, linear_idx);
+    }
+  });
+}
+
 static bool areAllReturnsTensors(const at::FunctionSchema& schema) {
   return std::all_of(
       schema.returns().begin(),
@@ -98,6 +370,7 @@ static void warnFallback(const c10::FunctionSchema& schema, bool is_inplace) {
 void batchedTensorInplaceForLoopFallback(const c10::OperatorHandle& op, torch::jit::Stack* stack) {
   const auto& schema = op.schema();
   warnFallback(schema, /*in_place*/true);
+  FallbackProfileRecorder profile_recorder(schema);
 
   const auto num_arguments = schema.arguments().size();
   const auto arguments = torch::jit::last(stack, num_arguments);
@@ -180,33 +453,31 @@ void batchedTensorInplaceForLoopFallback(const c10::OperatorHandle& op, torch::j
       "Batching rule not implemented for ", schema.operator_name(), ". ",
       "The fallback path does not support vmap over dims of size 0.");
 
+  profile_recorder.setNumSlices(num_batches);
+
   // Strategy: For each batch, we are going to push slices (where applicable)
   // of the arguments onto `stack`, and call `op`.
-  for (int64_t linear_idx = 0; linear_idx < num_batches; ++linear_idx) {
-    auto index = computeIndex(linear_idx, batch_sizes);
-    auto batched_tensor_inputs_pos_iter = batched_tensor_inputs_position.begin();
-    auto input_physical_views_iter = input_physical_views.begin();
-    for (const auto arg_idx : c10::irange(0, num_arguments)) {
-      // We assume that torch::jit::Stack is backed by vector<IValue> for
-      // simplicity. When that is not the case, this code should be updated.
-      const auto& argument = (*stack)[arguments_begin + arg_idx];
-      if (batched_tensor_inputs_pos_iter == batched_tensor_inputs_position.end()
-          || (int64_t)arg_idx != *batched_tensor_inputs_pos_iter) {
-        // argument isn't a BatchedTensor
-        torch::jit::push(stack, argument);
-        continue;
-      }
-      // argument is a BatchedTensor
-      TORCH_INTERNAL_ASSERT(input_physical_views_iter != input_physical_views.end());
-      const auto& physical_view_for_argument = *input_physical_views_iter;
-      auto thing = physical_view_for_argument.tensor().index(index);
-      torch::jit::push(stack, thing);
-      batched_tensor_inputs_pos_iter++;
-      input_physical_views_iter++;
+  const auto run_slice = [&](torch::jit::Stack* slice_stack, int64_t linear_idx) {
+    pushSlicedArguments(
+        slice_stack, *stack, arguments_begin, num_arguments,
+        batched_tensor_inputs_position, input_physical_views,
+        computeIndex(linear_idx, batch_sizes));
+    op.callBoxed(slice_stack);
+    torch::jit::drop(slice_stack, 1);
+  };
+
+  // Slices of `self` may only be written to concurrently if they don't overlap
+  // each other or any of the other arguments. See NOTE: [Parallel fallback]
+  if (batched_tensor_inputs_position.front() == 0 &&
+      at::has_internal_overlap(input_physical_views.front().tensor()) == MemOverlap::NO &&
+      canRunSlicesInParallel(schema, *stack, arguments_begin, input_physical_views, num_batches) &&
+      !anyArgumentMayOverlapSelf(*stack, arguments_begin, num_arguments, input_physical_views)) {
+    profile_recorder.setRanInParallel();
+    parallelForSlices(0, num_batches, run_slice);
+  } else {
+    for (int64_t linear_idx = 0; linear_idx < num_batches; ++linear_idx) {
+      run_slice(stack, linear_idx);
     }
-
-    op.callBoxed(stack);
-    torch::jit::drop(stack, 1);
   }
 
   // Return the tensor that was written to in-place
@@ -240,6 +511,92 @@ static Tensor safeStack(TensorList tensors) {
       "an issue on github.");
 }
 
+// NOTE: [Preallocated fallback outputs]
+// Instead of collecting every output slice and at::stack-ing them at the end
+// (which keeps two copies of every output alive), the first slice's results
+// tell us the shape and dtype of each return. We then allocate the batched
+// outputs once and write the remaining slices directly into views of them:
+// through the operator's out= overload if it has one, otherwise with copy_.
+//
+// We only do this when the first slice's results are plain Tensors that don't
+// require grad. Writing into views of a tensor is an in-place operation:
+// under autograd it would record one CopySlices node per slice, and if the
+// results are wrapped by a lower transform (a BatchedTensor or a
+// TensorWrapper) the buffer would be a captured Tensor that may not be
+// mutated. In those cases we fall back to stacking.
+static bool canPreallocateOutputs(ArrayRef<IValue> first_slice_returns) {
+  return std::all_of(
+      first_slice_returns.begin(),
+      first_slice_returns.end(),
+      [] (const IValue& ret) {
+        const auto& tensor = ret.toTensor();
+        if (!tensor.defined()) {
+          return true;
+        }
+        return !tensor.requires_grad() &&
+          !isBatchedTensor(tensor) &&
+          maybeGetTensorWrapper(tensor) == nullptr;
+      });
+}
+
+// Returns the out= overload of `schema` if there is one that takes exactly
+// the same arguments followed by one out Tensor per return, and all of the
+// returns are defined so there is something to write into.
+static optional<c10::OperatorHandle> maybeFindOutOverload(
+    const c10::FunctionSchema& schema, ArrayRef<IValue> first_slice_returns) {
+  const auto is_defined = [] (const IValue& ret) { return ret.toTensor().defined(); };
+  if (!std::all_of(first_slice_returns.begin(), first_slice_returns.end(), is_defined)) {
+    return nullopt;
+  }
+  auto out_op = c10::Dispatcher::singleton().findOp({schema.name(), "out"});
+  if (!out_op.has_value()) {
+    return nullopt;
+  }
+  const auto& out_schema = out_op->schema();
+  const auto num_arguments = schema.arguments().size();
+  const auto num_returns = schema.returns().size();
+  if (out_schema.arguments().size() != num_arguments + num_returns ||
+      out_schema.returns().size() != num_returns) {
+    return nullopt;
+  }
+  for (const auto idx : c10::irange(0, num_arguments)) {
+    const auto& out_arg = out_schema.arguments()[idx];
+    const auto& arg = schema.arguments()[idx];
+    if (out_arg.name() != arg.name() || !(*out_arg.type() == *arg.type())) {
+      return nullopt;
+    }
+  }
+  for (const auto idx : c10::irange(num_arguments, num_arguments + num_returns)) {
+    const auto& alias_info = out_schema.arguments()[idx].alias_info();
+    if (!alias_info || !alias_info->isWrite()) {
+      return nullopt;
+    }
+  }
+  return out_op;
+}
+
+// Checks that the result for one slice fits into the preallocated `output`.
+// If `written_in_place`, `slice` was produced by an out= overload and must
+// still be a view into `output` (i.e., the kernel didn't resize it).
+static void checkSliceMatchesOutput(const Tensor& output, const Tensor& slice, bool written_in_place) {
+  if (output.defined() != slice.defined()) {
+    // See NOTE [vmap through backward and undefined grad]
+    TORCH_CHECK(false,
+        "vmap: slow fallback received a mix of undefined and defined tensors ",
+        "as the result of an operation. This is not supported, please file us ",
+        "an issue on github.");
+  }
+  if (!output.defined()) {
+    return;
+  }
+  const auto expected_sizes = output.sizes().slice(1);
+  TORCH_CHECK(slice.sizes() == expected_sizes &&
+              (!written_in_place || slice.storage().is_alias_of(output.storage())),
+      "vmap: slow fallback expected every slice of the result of an operation to ",
+      "have size ", expected_sizes, " but got a slice of size ", slice.sizes(), ". ",
+      "This is not supported, please file us an issue on github.");
+}
+
 // TODO: dedup
 static bool participatesInCurrentLevel(const Tensor& self) {
   auto maybe_level = maybeCurrentDynamicLayer();
@@ -261,6 +618,130 @@ static bool ivalueParticipatesInCurrentLevel(const IValue& ivalue) {
   return participatesInCurrentLevel(ivalue.toTensor());
 }
 
+// NOTE: [Batched-call fallback]
+// Some operators don't have a batching rule but are perfectly happy to be
+// called on the physical (batched) tensors directly:
+// - pointwise operators broadcast over the extra batch dimension, and
+// - many NN operators already loop over a leading batch dimension that
+//   the vmap dimension can be folded into.
+// For these operators the fallback issues exactly one call to `op` instead of
+// one call per slice followed by an at::stack. Eligibility is opt-in and is
+// recorded per-operator in batchedCallTable(); everything else (and any call
+// that doesn't fit the recorded pattern) goes through the for-loop.
+enum class BatchedCallKind : uint8_t {
+  // All Tensor arguments broadcast against each other elementwise.
+  Pointwise,
+  // Every Tensor argument and return has a leading dimension that the kernel
+  // treats independently. The vmap dimension gets folded into it.
+  LeadingBatchDim,
+};
+
+struct BatchedCallInfo {
+  BatchedCallKind kind;
+  // Only used by LeadingBatchDim: the logical rank at which dim 0 of each
+  // Tensor argument is the leading batch dimension.
+  int64_t batched_rank;
+};
+
+static const std::unordered_map<c10::OperatorName, BatchedCallInfo>& batchedCallTable() {
+  static const std::unordered_map<c10::OperatorName, BatchedCallInfo> table = {
+    {c10::OperatorName("aten::copysign", "Tensor"), {BatchedCallKind::Pointwise, 0}},
+    {c10::OperatorName("aten::copysign", "Scalar"), {BatchedCallKind::Pointwise, 0}},
+    {c10::OperatorName("aten::max_pool3d_with_indices", ""), {BatchedCallKind::LeadingBatchDim, 5}},
+    {c10::OperatorName("aten::max_unpool2d", ""), {BatchedCallKind::LeadingBatchDim, 4}},
+    {c10::OperatorName("aten::max_unpool3d", ""), {BatchedCallKind::LeadingBatchDim, 5}},
+  };
+  return table;
+}
+
+// Returns true if `op` was handled with a single call.
+// Returns false (without touching `stack`) if the for-loop should be used.
+static bool batchedCallFallback(const c10::OperatorHandle& op, torch::jit::Stack* stack) {
+  const auto& schema = op.schema();
+  const auto& table = batchedCallTable();
+  const auto it = table.find(schema.operator_name());
+  if (it == table.end()) {
+    return false;
+  }
+  const auto& info = it->second;
+  const auto num_returns = schema.returns().size();
+  const auto num_arguments = schema.arguments().size();
+  const auto arguments_begin = stack->size() - num_arguments;
+  const auto cur_level = maybeCurrentDynamicLayer()->layerId();
+
+  // First figure out if this particular call fits the pattern. Nothing gets
+  // written to the stack until we've committed to the batched call.
+  SmallVector<UnpackedBatchedTensor, 5> tensor_inputs;
+  SmallVector<int64_t, 5> tensor_pos;
+  int64_t batch_size = -1;
+  int64_t max_logical_rank = 0;
+  bool has_zero_dim_batched_input = false;
+  bool has_mixed_dtypes = false;
+  optional<ScalarType> dtype;
+  for (const auto idx : c10::irange(0, num_arguments)) {
+    const auto& ivalue = (*stack)[arguments_begin + idx];
+    if (!ivalue.isTensor()) {
+      continue;
+    }
+    if (!ivalue.toTensor().defined()) {
+      return false;
+    }
+    auto unpacked = unwrapTensorAtLevel(ivalue.toTensor(), cur_level);
+    const auto& value = std::get<0>(unpacked);
+    const auto bdim = std::get<1>(unpacked);
+    const auto logical_rank = rankWithoutBatchDim(value, bdim);
+    if (info.kind == BatchedCallKind::LeadingBatchDim && logical_rank != info.batched_rank) {
+      return false;
+    }
+    if (bdim.has_value()) {
+      batch_size = value.size(*bdim);
+      has_zero_dim_batched_input |= (logical_rank == 0);
+    }
+    if (dtype.has_value() && *dtype != value.scalar_type()) {
+      has_mixed_dtypes = true;
+    }
+    dtype = value.scalar_type();
+    max_logical_rank = std::max(max_logical_rank, logical_rank);
+    tensor_inputs.push_back(std::move(unpacked));
+    tensor_pos.push_back(idx);
+  }
+  // The for-loop is responsible for erroring out on size-0 batches.
+  if (batch_size <= 0) {
+    return false;
+  }
+  // A batched 0-dim input becomes a dimensioned tensor in the batched call,
+  // which changes its priority in type promotion.
+  if (info.kind == BatchedCallKind::Pointwise && has_zero_dim_batched_input && has_mixed_dtypes) {
+    return false;
+  }
+
+  c10::impl::ExcludeDispatchKeyGuard guard(kBatchedKey);
+  for (const auto tensor_idx : c10::irange(0, tensor_inputs.size())) {
+    const auto& value = std::get<0>(tensor_inputs[tensor_idx]);
+    const auto bdim = std::get<1>(tensor_inputs[tensor_idx]);
+    Tensor physical;
+    if (info.kind == BatchedCallKind::Pointwise) {
+      physical = maybePadToLogicalRank(moveBatchDimToFront(value, bdim), bdim, max_logical_rank);
+    } else {
+      physical = reshape_dim_into(
+          bdim.value_or(0), 0, ensure_has_bdim(value, bdim.has_value(), batch_size));
+    }
+    (*stack)[arguments_begin + tensor_pos[tensor_idx]] = std::move(physical);
+  }
+
+  op.callBoxed(stack);
+
+  for (const auto idx : c10::irange(arguments_begin, arguments_begin + num_returns)) {
+    const auto& ret = (*stack)[idx].toTensor();
+    if (info.kind == BatchedCallKind::Pointwise) {
+      (*stack)[idx] = makeBatched(ret, 0, cur_level);
+    } else {
+      (*stack)[idx] = makeBatched(reshape_dim_outof(0, batch_size, ret), 0, cur_level);
+    }
+  }
+  return true;
+}
+
 // TODO: Consider rewriting the following to look like:
 // https://gist.github.com/zou3519/7b7c6a4a258d580f62d1d969851be6b1<Paste>
 
@@ -304,6 +785,13 @@ void batchedTensorForLoopFallback(const c10::OperatorHandle& op, torch::jit::Sta
               "Batching rule not implemented for ", schema.operator_name(), ". ",
               "The fallback path does not support operations with no returns.");
   warnFallback(schema, /*in_place*/false);
+  FallbackProfileRecorder profile_recorder(schema);
+
+  // See NOTE: [Batched-call fallback]
+  if (isVmapBatchedCallFallbackEnabled() && batchedCallFallback(op, stack)) {
+    profile_recorder.setNumSlices(1);
+    return;
+  }
 
   const auto arguments_begin = stack->size() - num_arguments;
 
@@ -345,9 +833,12 @@ void batchedTensorForLoopFallback(const c10::OperatorHandle& op, torch::jit::Sta
       "Batching rule not implemented for ", schema.operator_name(), ". ",
       "The fallback path does not support vmap over dims of size 0.");
 
+  profile_recorder.setNumSlices(num_batches);
+
   // Strategy: For each batch, we are going to push slices (where applicable)
-  // of the arguments onto `stack`, call `op`, and store the result in
-  // `output_shards`.
+  // of the arguments onto `stack`, call `op`, and write the result into
+  // the batched outputs (see NOTE: [Preallocated fallback outputs]) or store
+  // it in `output_shards`.
   //
   // NOTE: [Output shards layout]
   // Assume that the operator has three outputs: a, b, c.
@@ -355,52 +846,99 @@ void batchedTensorForLoopFallback(const c10::OperatorHandle& op, torch::jit::Sta
   // [ a0, a1, a2, a3, b0, b1, b2, b3, c0, c1, c2, c3]
   // This is so that we can call at::stack([a0...a3]), at::stack([b0...b3])
   // more easily in the next step.
-  std::vector<Tensor> output_shards(num_batches * num_returns);
-
-  for (int64_t linear_idx = 0; linear_idx < num_batches; ++linear_idx) {
-    auto index = computeIndex(linear_idx, batch_sizes);
-    auto batched_tensor_inputs_pos_iter = batched_tensor_inputs_position.begin();
-    auto input_physical_views_iter = input_physical_views.begin();
-    for (const auto arg_idx : c10::irange(0, num_arguments)) {
-      // We assume that torch::jit::Stack is backed by vector<IValue> for
-      // simplicity. When that is not the case, this code should be updated.
-      const auto& argument = (*stack)[arguments_begin + arg_idx];
-      if (batched_tensor_inputs_pos_iter == batched_tensor_inputs_position.end()
-          || (int64_t)arg_idx != *batched_tensor_inputs_pos_iter) {
-        // argument isn't a BatchedTensor
-        torch::jit::push(stack, argument);
+  std::vector<Tensor> output_shards;
+  std::vector<Tensor> flat_outputs(num_returns);
+  bool preallocated = false;
+  optional<c10::OperatorHandle> out_op;
+
+  const auto push_slice = [&](torch::jit::Stack* slice_stack, int64_t linear_idx) {
+    pushSlicedArguments(
+        slice_stack, *stack, arguments_begin, num_arguments,
+        batched_tensor_inputs_position, input_physical_views,
+        computeIndex(linear_idx, batch_sizes));
+  };
+  const auto store_results = [&](ArrayRef<IValue> returns, int64_t linear_idx) {
+    for (const auto return_idx : c10::irange(0, returns.size())) {
+      const auto& result = returns[return_idx].toTensor();
+      if (!preallocated) {
+        // Store the result into `output_shards`. See NOTE: [Output shards layout]
+        // to learn about the details of how we store the shards.
+        output_shards[num_batches * return_idx + linear_idx] = result;
         continue;
       }
-      // argument is a BatchedTensor
-      TORCH_INTERNAL_ASSERT(input_physical_views_iter != input_physical_views.end());
-      const auto& physical_view_for_argument = *input_physical_views_iter;
-      c10::impl::ExcludeDispatchKeyGuard guard(kBatchedKey);
-      torch::jit::push(stack, physical_view_for_argument.tensor().index(index));
-      batched_tensor_inputs_pos_iter++;
-      input_physical_views_iter++;
+      checkSliceMatchesOutput(flat_outputs[return_idx], result, /*written_in_place*/false);
+      if (result.defined()) {
+        flat_outputs[return_idx].select(0, linear_idx).copy_(result);
+      }
     }
+  };
 
+  // The first slice tells us the shapes and dtypes of the results.
+  {
+    c10::impl::ExcludeDispatchKeyGuard guard(kBatchedKey);
+    push_slice(stack, 0);
     // std::cout << "[Fallback]: ";
     // at::dump_tensor((*stack)[stack->size() - 1].toTensor());
-    c10::impl::ExcludeDispatchKeyGuard guard(kBatchedKey);
     op.callBoxed(stack);
 
-    // Store the result into `output_shards`. See NOTE: [Output shards layout]
-    // to learn about the details of how we store the shards.
     const auto returns = torch::jit::last(stack, num_returns);
-    for (const auto  return_idx : c10::irange(0, returns.size())) {
-      output_shards[num_batches * return_idx + linear_idx] = returns[return_idx].toTensor();
+    preallocated = canPreallocateOutputs(returns);
+    if (preallocated) {
+      for (const auto return_idx : c10::irange(0, returns.size())) {
+        const auto& first_slice = returns[return_idx].toTensor();
+        if (!first_slice.defined()) {
+          continue;
+        }
+        VmapDimVector output_sizes = {num_batches};
+        output_sizes.insert(output_sizes.end(), first_slice.sizes().begin(), first_slice.sizes().end());
+        flat_outputs[return_idx] = at::empty(output_sizes, first_slice.options());
+      }
+      out_op = maybeFindOutOverload(schema, returns);
+    } else {
+      output_shards.resize(num_batches * num_returns);
     }
+    store_results(returns, 0);
     torch::jit::drop(stack, num_returns);
   }
 
+  const auto run_slice = [&](torch::jit::Stack* slice_stack, int64_t linear_idx) {
+    c10::impl::ExcludeDispatchKeyGuard guard(kBatchedKey);
+    push_slice(slice_stack, linear_idx);
+    if (out_op.has_value()) {
+      // Have the out= overload write straight into the batched outputs.
+      for (const auto return_idx : c10::irange(0, num_returns)) {
+        torch::jit::push(slice_stack, flat_outputs[return_idx].select(0, linear_idx));
+      }
+      out_op->callBoxed(slice_stack);
+      const auto returns = torch::jit::last(slice_stack, num_returns);
+      for (const auto return_idx : c10::irange(0, returns.size())) {
+        checkSliceMatchesOutput(flat_outputs[return_idx], returns[return_idx].toTensor(), /*written_in_place*/true);
+      }
+    } else {
+      op.callBoxed(slice_stack);
+      store_results(torch::jit::last(slice_stack, num_returns), linear_idx);
+    }
+    torch::jit::drop(slice_stack, num_returns);
+  };
+
+  // Each slice writes to its own entries of `output_shards` / its own views of
+  // `flat_outputs`, so slices may run concurrently.
+  if (canRunSlicesInParallel(schema, *stack, arguments_begin, input_physical_views, num_batches)) {
+    profile_recorder.setRanInParallel();
+    parallelForSlices(1, num_batches, run_slice);
+  } else {
+    for (int64_t linear_idx = 1; linear_idx < num_batches; ++linear_idx) {
+      run_slice(stack, linear_idx);
+    }
+  }
+
   // For each output Tensor, stack the shards of the tensor together to form a return
   torch::jit::drop(stack, num_arguments);
   auto output_shards_chunks = MatrixRef<Tensor>(output_shards, num_batches);
   for (const auto return_idx : c10::irange(0, num_returns)) {
-    auto shards = output_shards_chunks[return_idx];
     c10::impl::ExcludeDispatchKeyGuard guard(kBatchedKey);
-    auto flat_output = safeStack(shards);
+    auto flat_output = preallocated ? flat_outputs[return_idx] : safeStack(output_shards_chunks[return_idx]);
+    profile_recorder.addBytesMaterialized(flat_output);
     // See NOTE [vmap through backward and undefined grad]
     if (!flat_output.defined()) {
       torch::jit::push(stack, flat_output);
@@ -9,6 +9,9 @@
 #include <ATen/core/op_registration/op_registration.h>
 #include <torch/library.h>
 
+#include <map>
+#include <string>
+
 namespace at {
 namespace functorch {
 
@@ -19,12 +22,12 @@ namespace functorch {
 //
 // The fallback effectively takes all of the BatchedTensors in `stack`, slices
 // them, and runs `op` on all of the corresponding slices to produce slices
-// of the outputs. The output slices then get `torch.stack`ed to create the
-// final returns.
+// of the outputs. The output slices get written into (or, if that isn't
+// possible, `torch.stack`ed to create) the final returns.
 //
-// The performance of the fallback is not very good because it introduces an
-// extra copy from stacking the sliced outputs. Because of this, we prefer to
-// write batching rules for operators whenever possible.
+// The performance of the fallback is not very good because it calls `op` once
+// per slice and introduces an extra copy of the sliced outputs. Because of
+// this, we prefer to write batching rules for operators whenever possible.
 void batchedTensorForLoopFallback(const c10::OperatorHandle& op, torch::jit::Stack* stack);
 
 bool isVmapFallbackWarningEnabled();
@@ -33,6 +36,35 @@ void setVmapFallbackWarningEnabled(bool enabled);
 bool isVmapFallbackEnabled();
 void setVmapFallbackEnabled(bool enabled);
 
+// Controls whether operators recorded as batched-call eligible skip the
+// per-slice for-loop. See NOTE: [Batched-call fallback] in BatchedFallback.cpp.
+bool isVmapBatchedCallFallbackEnabled();
+void setVmapBatchedCallFallbackEnabled(bool enabled);
+
+// Controls whether the fallback may run independent slices of CPU operators
+// concurrently on the intra-op thread pool. Off by default.
+// See NOTE: [Parallel fallback] in BatchedFallback.cpp.
+bool isVmapParallelFallbackEnabled();
+void setVmapParallelFallbackEnabled(bool enabled);
+
+// Per-operator statistics recorded by the fallbacks while profiling is enabled.
+// See NOTE: [Fallback profiler] in BatchedFallback.cpp.
+struct VmapFallbackStats {
+  int64_t num_calls = 0;
+  int64_t num_slices = 0;
+  int64_t total_time_ns = 0;
+  int64_t bytes_materialized = 0;
+  // Number of calls that ran their slices in parallel.
+  // See NOTE: [Parallel fallback] in BatchedFallback.cpp.
+  int64_t num_parallel_calls = 0;
+};
+
+bool isVmapFallbackProfilingEnabled();
+void setVmapFallbackProfilingEnabled(bool enabled);
+void resetVmapFallbackProfile();
+std::map<std::string, VmapFallbackStats> getVmapFallbackProfile();
+std::string dumpVmapFallbackProfileJson();
+
 template <typename A> A vector_to_result(const std::vector<IValue>& buffer) {
   return buffer[0].to<A>();
 }
@@ -16,6 +16,9 @@
 #include <torch/csrc/jit/tensorexpr/codegen.h>
 #include <torch/csrc/utils/pybind.h>
 
+#include <c10/util/SmallVector.h>
+#include <c10/util/hash.h>
+
 using namespace torch::jit::tensorexpr;
 
 namespace {
@@ -43,7 +46,32 @@ static uint8_t packFlags(const LocalState &state, const at::Tensor &v) {
          (static_cast<uint8_t>(dtype) << 1);
 }
 
-using hash_key_t = std::vector<int64_t>;
+/// Specialization key that is built and hashed incrementally as values are
+/// appended. Values live in inline storage, so building the key for a lookup
+/// does not allocate for typical argument counts.
+class CacheKey {
+public:
+  static constexpr size_t kInlineSize = 64;
+
+  void push_back(int64_t value) {
+    values_.push_back(value);
+    hash_ = c10::hash_combine(hash_, static_cast<size_t>(value));
+  }
+
+  template <typename Iter> void append(Iter begin, Iter end) {
+    for (; begin != end; ++begin) {
+      push_back(*begin);
+    }
+  }
+
+  size_t hash() const { return hash_; }
+  c10::ArrayRef<int64_t> values() const { return values_; }
+
+private:
+  c10::SmallVector<int64_t, kInlineSize> values_;
+  size_t hash_ = 0;
+};
+
 /// Per-tensor cache specialization key targetting dynamic shapes. Records
 /// dtype, dispatch options, aliasing, and per-dim contiguity/broadcasting
 /// information.
@@ -84,10 +112,18 @@ enum HasherFlags {
   DYNAMIC_HASH,
 };
 
-std::vector<int> genDimFlags(c10::IntArrayRef sizes, c10::IntArrayRef strides) {
-  // Pack all the properties for each dimension into a uint8.
+/// Hashers selectable from Python. Resolved once when the caller is set up, so
+/// that the lookup path doesn't compare hasher names per tensor.
+enum class HasherType {
+  StaticShapeHasher,
+  DynamicShapeHasher,
+};
+
+/// Append the properties for each dimension, packed into a uint8, to `key`.
+void appendDimFlags(c10::IntArrayRef sizes, c10::IntArrayRef strides,
+                    CacheKey &key) {
   int nDims = sizes.size();
-  std::vector<int> dimflags(nDims);
+  uint8_t prevFlag = 0;
   for (int64_t dim = 0; dim < nDims; ++dim) {
     uint8_t flag =
         (sizes[dim] == 0 ? SIZE_MISSING
@@ -100,36 +136,216 @@ std::vector<int> genDimFlags(c10::IntArrayRef sizes, c10::IntArrayRef strides) {
                strides[dim] == strides[dim + 1] * sizes[dim + 1]) {
       flag |= STRIDE_CONTIGUOUS;
     } else if (dim > 0 && strides[dim] == strides[dim - 1] * sizes[dim - 1] &&
-               (dimflags[dim - 1] & STRIDE_CONTIGUOUS) == 0) {
+               (prevFlag & STRIDE_CONTIGUOUS) == 0) {
       flag |= STRIDE_TRANSPOSED_CONTIGUOUS;
     } else {
       flag |= STRIDE_AS_ARG;
     }
-    dimflags[dim] = flag;
+    key.push_back(flag);
+    prevFlag = flag;
   }
-  return dimflags;
 }
 
-hash_key_t dynamic_hasher(const LocalState &state, const at::Tensor &v) {
-  hash_key_t hash = {DYNAMIC_HASH, static_cast<int>(packFlags(state, v)),
-                     static_cast<int>(state.apply(v.key_set()).raw_repr()),
-                     static_cast<int>(v.ndimension())};
-  auto dimFlags = genDimFlags(v.sizes(), v.strides());
-  hash.insert(hash.end(), dimFlags.begin(), dimFlags.end());
-  return hash;
+void dynamic_hasher(const LocalState &state, const at::Tensor &v,
+                    CacheKey &key) {
+  key.push_back(DYNAMIC_HASH);
+  key.push_back(static_cast<int>(packFlags(state, v)));
+  key.push_back(static_cast<int>(state.apply(v.key_set()).raw_repr()));
+  key.push_back(static_cast<int>(v.ndimension()));
+  appendDimFlags(v.sizes(), v.strides(), key);
 }
 
 /// Per-tensor cache specialization key targetting static shapes. Recordsdtype,
 /// dispatch options, aliasing, and full shapes and strides.
-hash_key_t static_hasher(const LocalState &state, const at::Tensor &v) {
-  hash_key_t hash = {STATIC_HASH, static_cast<int>(packFlags(state, v)),
-                     static_cast<int>(state.apply(v.key_set()).raw_repr()),
-                     static_cast<int>(v.ndimension())};
-  hash.insert(hash.end(), v.sizes().begin(), v.sizes().end());
-  hash.insert(hash.end(), v.strides().begin(), v.strides().end());
-  return hash;
+void static_hasher(const LocalState &state, const at::Tensor &v,
+                   CacheKey &key) {
+  key.push_back(STATIC_HASH);
+  key.push_back(static_cast<int>(packFlags(state, v)));
+  key.push_back(static_cast<int>(state.apply(v.key_set()).raw_repr()));
+  key.push_back(static_cast<int>(v.ndimension()));
+  key.append(v.sizes().begin(), v.sizes().end());
+  key.append(v.strides().begin(), v.strides().end());
 }
 
+/// Open-addressing hash table (linear probing) mapping specialization keys to
+/// compiled functions. Slots are stored contiguously and remember the full
+/// hash of their key, so a probe only compares key values on a hash match.
+///
+/// The table can be bounded by number of entries and by the (caller estimated)
+/// bytes held by the compiled functions. Entries are evicted with the CLOCK
+/// (second chance) policy: a hit marks the slot as referenced, and the clock
+/// hand evicts the first unreferenced entry it finds, clearing the mark of the
+/// referenced ones it passes.
+class FlatCache {
+public:
+  const py::object *find(const CacheKey &key) {
+    if (slots_.empty()) {
+      return nullptr;
+    }
+    for (size_t idx = slotIndex(key.hash());; idx = (idx + 1) & mask()) {
+      Slot &slot = slots_[idx];
+      if (!slot.occupied()) {
+        return nullptr;
+      }
+      if (slot.matches(key)) {
+        slot.referenced = true;
+        return &slot.value;
+      }
+    }
+  }
+
+  /// Insert `value` under `key`, unless `key` is already present. Makes room
+  /// for the new entry first when the cache is bounded. Entries larger than
+  /// the byte limit are not cached, rather than flushing the whole cache.
+  void emplace(const CacheKey &key, const py::object &value, int64_t nbytes) {
+    if (find(key) != nullptr) {
+      return;
+    }
+    if (max_bytes_ > 0 && nbytes > max_bytes_) {
+      rejected_++;
+      return;
+    }
+    while (size_ > 0 && exceedsCapacity(size_ + 1, bytes_ + nbytes)) {
+      evictOne();
+    }
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+      size_t capacity = slots_.size() * 2;
+      if (capacity < kMinCapacity) {
+        capacity = kMinCapacity;
+      }
+      rehash(capacity);
+    }
+    size_t idx = slotIndex(key.hash());
+    while (slots_[idx].occupied()) {
+      idx = (idx + 1) & mask();
+    }
+    Slot &slot = slots_[idx];
+    slot.hash = key.hash();
+    slot.key.assign(key.values().begin(), key.values().end());
+    slot.value = value;
+    slot.nbytes = nbytes;
+    slot.referenced = false;
+    size_++;
+    bytes_ += nbytes;
+  }
+
+  /// Bound the cache; 0 means unbounded. Evicts entries right away if the
+  /// cache is over the new limits.
+  void setCapacity(int64_t max_entries, int64_t max_bytes) {
+    max_entries_ = max_entries;
+    max_bytes_ = max_bytes;
+    while (size_ > 0 && exceedsCapacity(size_, bytes_)) {
+      evictOne();
+    }
+  }
+
+  size_t size() const { return size_; }
+  int64_t bytes() const { return bytes_; }
+  int64_t evictions() const { return evictions_; }
+  int64_t rejected() const { return rejected_; }
+
+  void clear() {
+    slots_.clear();
+    size_ = 0;
+    bytes_ = 0;
+    hand_ = 0;
+  }
+
+private:
+  static constexpr size_t kMinCapacity = 16;
+
+  struct Slot {
+    size_t hash = 0;
+    std::vector<int64_t> key;
+    /// Null for an empty slot.
+    py::object value;
+    int64_t nbytes = 0;
+    bool referenced = false;
+
+    bool occupied() const { return static_cast<bool>(value); }
+    bool matches(const CacheKey &other) const {
+      return hash == other.hash() && c10::ArrayRef<int64_t>(key) == other.values();
+    }
+  };
+
+  size_t mask() const { return slots_.size() - 1; }
+
+  /// The incremental key hash is weak in its low bits, so mix it before
+  /// picking a slot in the power-of-two sized table.
+  size_t slotIndex(size_t hash) const {
+    return static_cast<size_t>((static_cast<uint64_t>(hash) *
+                                0x9e3779b97f4a7c15ULL) >> 32) &
+           mask();
+  }
+
+  bool exceedsCapacity(size_t entries, int64_t bytes) const {
+    return (max_entries_ > 0 && (int64_t)entries > max_entries_) ||
+           (max_bytes_ > 0 && bytes > max_bytes_);
+  }
+
+  void evictOne() {
+    for (;; hand_ = (hand_ + 1) & mask()) {
+      Slot &slot = slots_[hand_];
+      if (!slot.occupied()) {
+        continue;
+      }
+      if (slot.referenced) {
+        slot.referenced = false;
+        continue;
+      }
+      erase(hand_);
+      evictions_++;
+      return;
+    }
+  }
+
+  /// Remove the entry at `idx`, shifting back the entries of its probe
+  /// sequence so that lookups don't need tombstones.
+  void erase(size_t idx) {
+    size_--;
+    bytes_ -= slots_[idx].nbytes;
+    slots_[idx] = Slot();
+    size_t hole = idx;
+    for (size_t next = (hole + 1) & mask(); slots_[next].occupied();
+         next = (next + 1) & mask()) {
+      // The entry may fill the hole if the hole lies between its home slot
+      // and where it currently is.
+      size_t home = slotIndex(slots_[next].hash);
+      if (((next - home) & mask()) >= ((next - hole) & mask())) {
+        slots_[hole] = std::move(slots_[next]);
+        slots_[next] = Slot();
+        hole = next;
+      }
+    }
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<Slot> old_slots(capacity);
+    old_slots.swap(slots_);
+    hand_ = 0;
+    for (auto &old_slot : old_slots) {
+      if (!old_slot.occupied()) {
+        continue;
+      }
+      size_t idx = slotIndex(old_slot.hash);
+      while (slots_[idx].occupied()) {
+        idx = (idx + 1) & mask();
+      }
+      slots_[idx] = std::move(old_slot);
+    }
+  }
+
+  std::vector<Slot> slots_;
+  size_t size_ = 0;
+  int64_t bytes_ = 0;
+  int64_t max_entries_ = 0;
+  int64_t max_bytes_ = 0;
+  size_t hand_ = 0;
+  int64_t evictions_ = 0;
+  /// Entries not cached because they alone exceed the byte limit.
+  int64_t rejected_ = 0;
+};
+
 /// ArgCompileCache is a templated class allowing plugging of different types of
 /// Hasher/Specialization Keys.
 struct CompileCache {
@@ -137,43 +353,38 @@ public:
   CompileCache() = default;
   ~CompileCache() = default;
 
-  /// Array defining groups of aliased tensors.
-
-  /// Cache type mapping specialization keys to compiled kernels.
-  class vector_hasher {
-  public:
-    std::size_t operator()(hash_key_t const &vec) const {
-      std::size_t seed = vec.size();
-      for (auto &i : vec) {
-        seed ^= i + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-      }
-      return seed;
-    }
-  };
-  using Cache = std::unordered_map<hash_key_t, py::object, vector_hasher>;
-
   /// Compute the set of specialization keys based on the inputs to
-  /// the kernel.
-  hash_key_t computeCacheKey(PyObject *args,
-                             const std::vector<at::Tensor> &tensorArgs,
-                             int numTensorArgs, const std::string &hasherType,
-                             int64_t id, int64_t fw_compiler_id,
-                             int64_t bw_compiler_id) {
+  /// the kernel. The tensor arguments are read straight from `args`.
+  template <HasherType kHasherType>
+  void computeCacheKey(PyObject *args, int numTensorArgs, int64_t id,
+                       int64_t fw_compiler_id, int64_t bw_compiler_id,
+                       CacheKey &cacheKey) {
     LocalState state;
-    hash_key_t cacheKey;
     for (int i = 0; i < numTensorArgs; ++i) {
-      if (tensorArgs[i].defined()) {
-        // Only hash the tensor when its defined.
-        if (hasherType == "StaticShapeHasher") {
-          auto res = static_hasher(state, tensorArgs[i]);
-          cacheKey.insert(cacheKey.end(), res.begin(), res.end());
-        } else if (hasherType == "DynamicShapeHasher") {
-          auto res = dynamic_hasher(state, tensorArgs[i]);
-          cacheKey.insert(cacheKey.end(), res.begin(), res.end());
-        }
-      } else {
+      PyObject *arg = PyTuple_GET_ITEM(args, i);
+      if (arg == Py_None) {
         // Add a value to the cacheKey to indicate a None tensor.
         cacheKey.push_back(NONE_HASH);
+        continue;
+      }
+      if (!THPVariable_Check(arg)) {
+        // Fail if its a non-tensor arg. It should be marked static.
+        std::string dtype = Py_TYPE(arg)->tp_name;
+        std::string index = std::to_string(i);
+        throw std::runtime_error("Found an argument of type " + dtype +
+                                 " at index " + index +
+                                 ". Non-tensor arguments must be marked static."
+                                 " Please set the static_argnums correctly to "
+                                 "mark the argument at index " +
+                                 index + " static.");
+      }
+      const at::Tensor &tensor = THPVariable_Unpack(arg);
+      if (!tensor.defined()) {
+        cacheKey.push_back(NONE_HASH);
+      } else if (kHasherType == HasherType::StaticShapeHasher) {
+        static_hasher(state, tensor, cacheKey);
+      } else {
+        dynamic_hasher(state, tensor, cacheKey);
       }
     }
     cacheKey.push_back(id);
@@ -187,71 +398,79 @@ public:
       assert(PyLong_Check(arg));
       cacheKey.push_back(PyLong_AsLong(arg));
     }
-    return cacheKey;
   }
 
-  std::vector<at::Tensor> parsePythonArgs(int numTensorArgs, PyObject *args) {
-    // Convert to Tensor Args
-    std::vector<at::Tensor> tensorArgs(numTensorArgs);
-    for (int i = 0; i < numTensorArgs; ++i) {
-      PyObject *arg = PyTuple_GET_ITEM(args, i);
-      if (arg == Py_None) {
-        // If an input tensor is None, add it as an undefined tensor.
-        tensorArgs[i] = at::Tensor();
-      } else if (!THPVariable_Check(arg)) {
-        // Fail if its a non-tensor arg. It should be marked static.
-        std::string dtype = Py_TYPE(arg)->tp_name;
-        std::string index = std::to_string(i);
-        throw std::runtime_error("Found an argument of type " + dtype +
-                                 " at index " + index +
-                                 ". Non-tensor arguments must be marked static."
-                                 " Please set the static_argnums correctly to "
-                                 "mark the argument at index " +
-                                 index + " static.");
-      } else {
-        tensorArgs[i] = THPVariable_Unpack(arg);
-      }
+  void computeCacheKey(PyObject *args, int numTensorArgs,
+                       HasherType hasherType, int64_t id,
+                       int64_t fw_compiler_id, int64_t bw_compiler_id,
+                       CacheKey &cacheKey) {
+    switch (hasherType) {
+    case HasherType::StaticShapeHasher:
+      return computeCacheKey<HasherType::StaticShapeHasher>(
+          args, numTensorArgs, id, fw_compiler_id, bw_compiler_id, cacheKey);
+    case HasherType::DynamicShapeHasher:
+      return computeCacheKey<HasherType::DynamicShapeHasher>(
+          args, numTensorArgs, id, fw_compiler_id, bw_compiler_id, cacheKey);
     }
-    return tensorArgs;
   }
 
   /// Check if the function has already been compiled.
   py::object at(int64_t id, int64_t fw_compiler_id, int64_t bw_compiler_id,
-                int numTensorArgs, const std::string &hasherType,
+                int numTensorArgs, HasherType hasherType,
                 PyObject *args) {
-    std::vector<at::Tensor> tensorArgs = parsePythonArgs(numTensorArgs, args);
-    hash_key_t cacheKey =
-        computeCacheKey(args, tensorArgs, numTensorArgs, hasherType, id,
-                        fw_compiler_id, bw_compiler_id);
+    CacheKey cacheKey;
+    computeCacheKey(args, numTensorArgs, hasherType, id, fw_compiler_id,
+                    bw_compiler_id, cacheKey);
 
     auto item = cache_.find(cacheKey); // protected by GIL
 
-    if (C10_LIKELY(item != cache_.end())) {
-      return item->second;
+    if (C10_LIKELY(item != nullptr)) {
+      hits_++;
+      return *item;
     }
+    misses_++;
     return py::none();
   }
 
   /// Insert a new compiled functions for new tensor properties.
   void insert(int64_t id, int64_t fw_compiler_id, int64_t bw_compiler_id,
-              int numTensorArgs, const std::string &hasherType,
-              const py::object &compileFn, PyObject *args) {
-    std::vector<at::Tensor> tensorArgs = parsePythonArgs(numTensorArgs, args);
-    LocalState state;
-    hash_key_t cacheKey =
-        computeCacheKey(args, tensorArgs, numTensorArgs, hasherType, id,
-                        fw_compiler_id, bw_compiler_id);
-    cache_.emplace(cacheKey, compileFn);
+              int numTensorArgs, HasherType hasherType,
+              const py::object &compileFn, PyObject *args, int64_t nbytes) {
+    CacheKey cacheKey;
+    computeCacheKey(args, numTensorArgs, hasherType, id, fw_compiler_id,
+                    bw_compiler_id, cacheKey);
+    cache_.emplace(cacheKey, compileFn, nbytes);
   }
 
   const int64_t size() const { return cache_.size(); }
 
-  /// Clear the cache.
+  /// Bound the cache by number of entries and by estimated bytes of the
+  /// compiled functions; 0 means unbounded.
+  void setCapacity(int64_t max_entries, int64_t max_bytes) {
+    cache_.setCapacity(max_entries, max_bytes);
+  }
+
+  /// Hit/miss/eviction counters, the number of entries too large to cache,
+  /// and the current size of the cache.
+  py::dict stats() const {
+    py::dict result;
+    result["hits"] = hits_;
+    result["misses"] = misses_;
+    result["evictions"] = cache_.evictions();
+    result["rejected"] = cache_.rejected();
+    result["size"] = cache_.size();
+    result["bytes"] = cache_.bytes();
+    return result;
+  }
+
+  /// Clear the cache. The counters are kept.
   void clear() { cache_.clear(); }
 
 private:
   /// Compilation cache holding key and the compiled function.
-  Cache cache_;
+  FlatCache cache_;
+  int64_t hits_ = 0;
+  int64_t misses_ = 0;
 };
 
 static CompileCache *createCompileCache() { return new CompileCache(); }
@@ -263,25 +482,39 @@ namespace functorch {
 
 void initCompileCacheBindings(PyObject *module) {
   py::handle te(module);
+  py::enum_<HasherType>(te, "HasherType")
+      .value("StaticShapeHasher", HasherType::StaticShapeHasher)
+      .value("DynamicShapeHasher", HasherType::DynamicShapeHasher);
   py::class_<CompileCache>(te, "CompileCache")
       .def(py::init(&createCompileCache))
       .def("at",
            [](CompileCache &self, int64_t id, int64_t fw_compiler_id,
               int64_t bw_compiler_id, int numTensorArgs,
-              const std::string &hasherType, py::args args) {
+              HasherType hasherType, py::args args) {
              return self.at(id, fw_compiler_id, bw_compiler_id, numTensorArgs,
                             hasherType, args.ptr());
            })
       .def("insert",
            [](CompileCache &self, int64_t id, int64_t fw_compiler_id,
               int64_t bw_compiler_id, int numTensorArgs,
-              const std::string &hasherType, const py::object &compileFn,
+              HasherType hasherType, const py::object &compileFn,
               py::args args, py::kwargs kwargs) {
+             // Estimated bytes held by `compileFn`, used to bound the cache.
+             int64_t nbytes = 0;
+             if (kwargs.contains("nbytes")) {
+               nbytes = kwargs["nbytes"].cast<int64_t>();
+             }
              self.insert(id, fw_compiler_id, bw_compiler_id, numTensorArgs,
-                         hasherType, compileFn, args.ptr());
+                         hasherType, compileFn, args.ptr(), nbytes);
            })
       .def("clear", [](CompileCache &self) { self.clear(); })
-      .def("size", [](CompileCache &self) { return self.size(); });
+      .def("size", [](CompileCache &self) { return self.size(); })
+      .def("set_capacity",
+           [](CompileCache &self, int64_t max_entries, int64_t max_bytes) {
+             self.setCapacity(max_entries, max_bytes);
+           },
+           py::arg("max_entries") = 0, py::arg("max_bytes") = 0)
+      .def("stats", [](CompileCache &self) { return self.stats(); });
 }
 
 } // namespace functorch
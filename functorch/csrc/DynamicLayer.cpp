@@ -54,16 +54,27 @@ DynamicLayer::DynamicLayer(
     optional<bool> prev_grad_mode)
   :
     key_(key),
-    layerId_(layerId),
-    batchSize_(batchSize),
-    randomness_(randomness),
-    prevGradMode_(prev_grad_mode)
+    layerId_(layerId)
 {
+  if (key_ == kBatchedKey) {
+    TORCH_INTERNAL_ASSERT(batchSize.has_value() && randomness.has_value());
+    vmap_.batchSize = *batchSize;
+    vmap_.randomness = *randomness;
+    return;
+  }
   if (key_ == DispatchKey::Autograd) {
     TORCH_INTERNAL_ASSERT(prev_grad_mode.has_value());
   }
+  prevGradMode_ = prev_grad_mode.value_or(false);
 }
 
+DynamicLayer::DynamicLayer()
+  :
+    key_(DispatchKey::Undefined),
+    layerId_(0),
+    prevGradMode_(false)
+{}
+
 DispatchKey DynamicLayer::key() const {
   return key_;
 }
@@ -73,33 +84,75 @@ int64_t DynamicLayer::layerId() const {
 }
 
 int64_t DynamicLayer::batchSize() const {
-  TORCH_INTERNAL_ASSERT(batchSize_);
-  return *batchSize_;
+  TORCH_INTERNAL_ASSERT(key_ == kBatchedKey);
+  return vmap_.batchSize;
 }
 
 RandomnessType DynamicLayer::randomness() const {
-  TORCH_INTERNAL_ASSERT(randomness_);
-  return *randomness_;
+  TORCH_INTERNAL_ASSERT(key_ == kBatchedKey);
+  return vmap_.randomness;
 }
 
 optional<bool> DynamicLayer::prevGradMode() const {
+  if (key_ != DispatchKey::Autograd) {
+    return nullopt;
+  }
   return prevGradMode_;
 }
 
-using DynmetaData = std::unordered_map<int64_t, std::shared_ptr<bool>>;
-DynmetaData kDynMetaDataSingleton;
+// Source of the generations of levels. Generations are unique across
+// threads, so a wrapper is only alive on threads where its transform is
+// active (or that inherited it, like the autograd engine's threads).
+static std::atomic<uint64_t> kNextGeneration{kDeadGeneration + 1};
 
-static DynmetaData& getGlobalDynmetaData() {
-  return kDynMetaDataSingleton;
-}
+// The DynamicLayer stack of a thread, stored inline. The layer at index i has
+// layer id i + 1.
+class DynamicLayerStack {
+ public:
+  int64_t size() const {
+    return size_;
+  }
+  const DynamicLayer& back() const {
+    TORCH_INTERNAL_ASSERT(size_ > 0);
+    return layers_[size_ - 1];
+  }
+  void push_back(const DynamicLayer& layer) {
+    TORCH_CHECK(size_ < kMaxDynamicLayers,
+        "functorch supports at most ", kMaxDynamicLayers - 1, " nested transforms");
+    layers_[size_++] = layer;
+  }
+  void pop_back() {
+    TORCH_INTERNAL_ASSERT(size_ > 0);
+    size_--;
+  }
+  void assign(ArrayRef<DynamicLayer> layers) {
+    TORCH_CHECK(static_cast<int64_t>(layers.size()) <= kMaxDynamicLayers,
+        "functorch supports at most ", kMaxDynamicLayers - 1, " nested transforms");
+    std::copy(layers.begin(), layers.end(), layers_.begin());
+    size_ = layers.size();
+  }
+  operator ArrayRef<DynamicLayer>() const {
+    return {layers_.data(), static_cast<size_t>(size_)};
+  }
+
+ private:
+  std::array<DynamicLayer, kMaxDynamicLayers> layers_;
+  int64_t size_ = 0;
+};
 
 class FuncTorchTLS : public FuncTorchTLSBase {
  public:
-  FuncTorchTLS() {}
+  FuncTorchTLS() {
+    // Initial autograd layer, because autograd is always "on"
+    // TODO: Get rid of this, it is bad for composability
+    dynamicLayerStack.push_back(DynamicLayer(DispatchKey::Autograd, 1, nullopt, nullopt, true));
+  }
 
   std::unique_ptr<FuncTorchTLSBase> deepcopy() const override {
     auto result = std::make_unique<FuncTorchTLS>();
-    result->dynamicLayerStack = dynamicLayerStack;
+    result->dynamicLayerStack.assign(dynamicLayerStack);
+    result->levelGenerations = levelGenerations;
+    result->numActiveLevels = numActiveLevels;
     return result;
   }
 
@@ -115,9 +168,15 @@ class FuncTorchTLS : public FuncTorchTLSBase {
     // Does nothing
   }
 
-  // Initial autograd layer, because autograd is always "on"
-  // TODO: Get rid of this, it is bad for composability
-  std::vector<DynamicLayer> dynamicLayerStack = { DynamicLayer(DispatchKey::Autograd, 1, nullopt, nullopt, true) };
+  DynamicLayerStack dynamicLayerStack;
+
+  // Generation of the transform active at each level, indexed by level, or
+  // kDeadGeneration if there is none. This is per thread, so transforms on
+  // different threads don't collide on level numbers. It is separate from
+  // the stack because the back fallbacks pop the top layer while the level
+  // is still alive.
+  std::array<uint64_t, kMaxDynamicLayers + 1> levelGenerations = {};
+  int64_t numActiveLevels = 0;
 };
 
 static FuncTorchTLS* getRawFunctorchTLS() {
@@ -131,14 +190,23 @@ static FuncTorchTLS* getRawFunctorchTLS() {
   return result;
 }
 
-static std::vector<DynamicLayer>& dynamicLayerStackAccessor() {
+static DynamicLayerStack& dynamicLayerStackAccessor() {
   return getRawFunctorchTLS()->dynamicLayerStack;
 }
 
-std::shared_ptr<bool> getLifeHandleForLevel(int64_t level) {
-  auto it = getGlobalDynmetaData().find(level);
-  TORCH_INTERNAL_ASSERT(it != kDynMetaDataSingleton.end(), "level should be alive");
-  return it->second;
+uint64_t getGenerationForLevel(int64_t level) {
+  TORCH_INTERNAL_ASSERT(level > 0 && level <= kMaxDynamicLayers);
+  auto generation = getRawFunctorchTLS()->levelGenerations[level];
+  TORCH_INTERNAL_ASSERT(generation != kDeadGeneration, "level should be alive");
+  return generation;
+}
+
+bool isLevelAlive(int64_t level, uint64_t generation) {
+  if (generation == kDeadGeneration) {
+    return false;
+  }
+  TORCH_INTERNAL_ASSERT_DEBUG_ONLY(level > 0 && level <= kMaxDynamicLayers);
+  return getRawFunctorchTLS()->levelGenerations[level] == generation;
 }
 
 optional<DynamicLayer> maybeCurrentDynamicLayer() {
@@ -150,17 +218,16 @@ optional<DynamicLayer> maybeCurrentDynamicLayer() {
   return dynamicLayerStack.back();
 }
 
-const std::vector<DynamicLayer>& getDynamicLayerStack() {
+ArrayRef<DynamicLayer> getDynamicLayerStack() {
   return dynamicLayerStackAccessor();
 }
 
-void setDynamicLayerStack(const std::vector<DynamicLayer>& stack) {
-  dynamicLayerStackAccessor() = stack;
+void setDynamicLayerStack(ArrayRef<DynamicLayer> stack) {
+  dynamicLayerStackAccessor().assign(stack);
 }
 
 bool areTransformsActive() {
-  const auto& data = getGlobalDynmetaData();
-  return !data.empty();
+  return getRawFunctorchTLS()->numActiveLevels > 0;
 }
 
 static DynamicLayer popDynamicLayer() {
@@ -186,7 +253,7 @@ static int64_t pushDynamicLayer(DynamicLayer&& dynamic_layer) {
   auto& dynamicLayerStack = dynamicLayerStackAccessor();
   int64_t layerId = 1 + dynamicLayerStack.size();
   TORCH_INTERNAL_ASSERT(layerId == dynamic_layer.layerId());
-  dynamicLayerStack.emplace_back(dynamic_layer);
+  dynamicLayerStack.push_back(dynamic_layer);
 
   if (layerId == 2) {
     setDynamicLayerFrontBackKeysIncluded(true);
@@ -206,13 +273,11 @@ int64_t initAndPushDynamicLayer(
   DynamicLayer new_layer(key, layerId, batch_size, randomness, prev_grad_mode);
   pushDynamicLayer(std::move(new_layer));
 
-  auto& data = getGlobalDynmetaData();
-
-  TORCH_INTERNAL_ASSERT(data.find(layerId) == data.end());
-  if (key == DispatchKey::Autograd) {
-    TORCH_INTERNAL_ASSERT(prev_grad_mode.has_value());
-  }
-  data[layerId] = std::make_shared<bool>(true);
+  auto* tls = getRawFunctorchTLS();
+  auto& generation = tls->levelGenerations[layerId];
+  TORCH_INTERNAL_ASSERT(generation == kDeadGeneration);
+  generation = kNextGeneration.fetch_add(1, std::memory_order_relaxed);
+  tls->numActiveLevels++;
   return layerId;
 }
 
@@ -220,25 +285,19 @@ DynamicLayer popDynamicLayerAndDeleteMetadata() {
   auto result = popDynamicLayer();
   auto level = result.layerId();
 
-  // TODO: is this lock safe? No one else should be writing to the same bucket
-  // if (c10::show_dispatch_trace_enabled()) {
-  //   std::cout << "deleting metadata" << std::endl;
-  // }
-  auto& data = getGlobalDynmetaData();
-  auto it = data.find(level);
-  if (it == data.end()) {
+  // Kill the wrappers of the level, unless it was never initialized (the
+  // initial autograd layer)
+  auto* tls = getRawFunctorchTLS();
+  auto& generation = tls->levelGenerations[level];
+  if (generation == kDeadGeneration) {
     return result;
   }
-  // if (c10::show_dispatch_trace_enabled()) {
-  //   std::cout << "deleted metadata for level " << level << std::endl;
-  // }
-  // invalidate the thing
-  *(it->second) = false;
-  data.erase(level);
+  generation = kDeadGeneration;
+  tls->numActiveLevels--;
   return result;
 }
 
-static Tensor materializeGradWrappers(const Tensor& tensor, const std::vector<DynamicLayer>& dynlayerStack) {
+static Tensor materializeGradWrappers(const Tensor& tensor, ArrayRef<DynamicLayer> dynlayerStack) {
   if (!tensor.defined()) {
     return tensor;
   }
@@ -274,48 +333,15 @@ static Tensor unwrapIfDead(const Tensor& tensor) {
   return wrapped->value();
 }
 
-void foreachTensorInplace(std::vector<IValue>& args, int64_t begin, int64_t end,
-    std::function<Tensor(const Tensor&)> func) {
+// Like foreachTensorInplace, but only visits args[begin + pos] for each pos in
+// positions, e.g. the arguments of an operator that can hold Tensors.
+template <typename Func>
+static void foreachTensorInplaceAt(std::vector<IValue>& args, int64_t begin,
+    ArrayRef<int64_t> positions, Func&& func) {
   TORCH_INTERNAL_ASSERT(begin >= 0);
-  TORCH_INTERNAL_ASSERT(end >= 0);
-  TORCH_INTERNAL_ASSERT(begin <= end);
-  for (int64_t idx = begin; idx < end; idx++) {
-    auto ivalue = args[idx];
-    // Tensor?[] translates to a c10::List<IValue> so we need to peek inside List
-    if (ivalue.isList()) {
-      bool modified = false;
-      // TODO: might be more efficient if we scan first then not copy? Depends.
-      auto list = ivalue.toList().copy();
-      for (const auto list_idx : c10::irange(0, list.size())) {
-        const auto& elt = list.get(list_idx);
-        if (elt.isTensor()) {
-          list.set(list_idx, func(elt.toTensor()));
-          modified = true;
-        }
-      }
-      if (modified) {
-        args[idx] = list;
-      }
-      continue;
-    }
-    if (ivalue.isTensorList()) {
-      auto list = ivalue.toTensorList();
-      for (const auto list_idx : c10::irange(0, list.size())) {
-        list[list_idx] = func(list[list_idx]);
-      }
-      args[idx] = list;
-    }
-    TORCH_INTERNAL_ASSERT(!ivalue.isGenericDict(), "No operators can accept GenericDict");
-    if (!ivalue.isTensor()) {
-      continue;
-    }
-    Tensor value = ivalue.toTensor();
-    Tensor replacement = func(value);
-    args[idx] = std::move(replacement);
-    // sanity checks
-    if (ivalue.toTensor().defined()) {
-      TORCH_INTERNAL_ASSERT(args[idx].toTensor().defined());
-    }
+  for (const auto pos : positions) {
+    TORCH_INTERNAL_ASSERT(begin + pos < static_cast<int64_t>(args.size()));
+    transformTensorsInplace(args[begin + pos], func);
   }
 }
 
@@ -323,7 +349,7 @@ std::ostream& operator<< (std::ostream& os, const DynamicLayer& layer) {
   os << layer.layerId() << ":" << layer.key();
   return os;
 }
-std::ostream& operator<< (std::ostream& os, const std::vector<DynamicLayer>& dls) {
+std::ostream& operator<< (std::ostream& os, ArrayRef<DynamicLayer> dls) {
   os << "DynamicLayerStack[ ";
   for (const auto& layer : dls) {
     os << layer << " ";
@@ -332,10 +358,13 @@ std::ostream& operator<< (std::ostream& os, const std::vector<DynamicLayer>& dls
   return os;
 }
 
+template <typename Pred>
 static bool allTensors(
     ArrayRef<IValue> args,
-    std::function<bool(const Tensor&)> pred) {
-  for (const auto& ivalue : args) {
+    ArrayRef<int64_t> positions,
+    Pred&& pred) {
+  for (const auto pos : positions) {
+    const auto& ivalue = args[pos];
     // Tensor?[] translates to a c10::List<IValue> so we need to peek inside List
     if (ivalue.isList()) {
       for (const auto& elt : ivalue.toListRef()) {
@@ -364,11 +393,13 @@ static bool allTensors(
   return true;
 }
 
+template <typename Pred>
 static bool anyTensors(
     ArrayRef<IValue> args,
-    std::function<bool(const Tensor&)> pred) {
+    ArrayRef<int64_t> positions,
+    Pred&& pred) {
   // Demorgan's law
-  return !allTensors(args, [&](const Tensor& self) { return !pred(self); });
+  return !allTensors(args, positions, [&](const Tensor& self) { return !pred(self); });
 }
 
 static void sanityCheckStack(const c10::OperatorHandle& op, torch::jit::Stack* stack) {
@@ -385,9 +416,7 @@ static void sanityCheckStack(const c10::OperatorHandle& op, torch::jit::Stack* s
 }
 
 static bool batchedAtCurrentLevel(const Tensor& tensor) {
-  auto& dynamicLayerStack = dynamicLayerStackAccessor();
-  auto layer = dynamicLayerStack.back();
-  auto level = layer.layerId();
+  auto level = dynamicLayerStackAccessor().back().layerId();
 
   auto* batched = maybeGetBatchedImpl(tensor);
   if (!batched) {
@@ -422,10 +451,113 @@ bool isInplaceOp(const FunctionSchema& schema) {
   return return_alias_info && return_alias_info->isWrite();
 }
 
+// Whether an argument or return of this type can hold Tensors, e.g. Tensor,
+// Tensor? or Tensor?[].
+static bool mayHoldTensors(const TypePtr& type) {
+  if (type->kind() == TypeKind::TensorType || type->kind() == TypeKind::AnyType) {
+    return true;
+  }
+  for (const auto& contained : type->containedTypes()) {
+    if (mayHoldTensors(contained)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Facts about an operator that the fallbacks would otherwise recompute from
+// its schema on every call.
+struct OperatorInfo {
+  int64_t numArgs;
+  int64_t numReturns;
+  // See isInplaceOp
+  bool isInplace;
+  // Whether the operator writes to any of its arguments. If it does, the
+  // grad back fallback has to keep the original (wrapped) arguments around
+  // to refresh their metadata after the call, since the write may have
+  // changed their sizes or strides.
+  bool mutatesArguments;
+  // Positions of the arguments and returns that can hold Tensors, so the
+  // fallbacks only look at those.
+  std::vector<int64_t> tensorArgs;
+  std::vector<int64_t> tensorReturns;
+};
+
+static OperatorInfo computeOperatorInfo(const FunctionSchema& schema) {
+  OperatorInfo info;
+  info.numArgs = schema.arguments().size();
+  info.numReturns = schema.returns().size();
+  info.isInplace = isInplaceOp(schema);
+  info.mutatesArguments = schema.is_mutable();
+  for (const auto idx : c10::irange(0, info.numArgs)) {
+    if (mayHoldTensors(schema.arguments()[idx].type())) {
+      info.tensorArgs.push_back(idx);
+    }
+  }
+  for (const auto idx : c10::irange(0, info.numReturns)) {
+    if (mayHoldTensors(schema.returns()[idx].type())) {
+      info.tensorReturns.push_back(idx);
+    }
+  }
+  return info;
+}
+
+// Number of operators deregistered so far. Deregistering an operator frees
+// its schema, so a later operator may get a schema at the same address.
+static std::atomic<uint64_t> operatorDeregistrations{0};
+
+struct CountOperatorDeregistrations : public c10::OpRegistrationListener {
+  void onOperatorRegistered(const c10::OperatorHandle&) override {}
+  void onOperatorDeregistered(const c10::OperatorHandle&) override {
+    operatorDeregistrations.fetch_add(1, std::memory_order_release);
+  }
+};
+
+static bool operator==(const OperatorInfo& a, const OperatorInfo& b) {
+  return a.numArgs == b.numArgs && a.numReturns == b.numReturns &&
+      a.isInplace == b.isInplace && a.mutatesArguments == b.mutatesArguments &&
+      a.tensorArgs == b.tensorArgs && a.tensorReturns == b.tensorReturns;
+}
+
+// Returns the OperatorInfo of op, computed the first time each thread sees it.
+// Operators are identified by the address of their registered schema, which
+// is stable for as long as the operator is registered. After an operator gets
+// deregistered, a new operator may reuse the address, so entries are checked
+// against the schema again on their next use. They are only replaced if the
+// schema changed: callers up the stack may still be using the info of live
+// operators.
+static const OperatorInfo& getOperatorInfo(const c10::OperatorHandle& op) {
+  struct Entry {
+    OperatorInfo info;
+    // Value of operatorDeregistrations when info was last checked.
+    uint64_t deregistrations;
+  };
+  // Leaked, so it is never removed during static destruction.
+  static auto* listener_handle = new c10::RegistrationHandleRAII(
+      c10::Dispatcher::singleton().addRegistrationListener(
+          std::make_unique<CountOperatorDeregistrations>()));
+  (void)listener_handle;
+  static thread_local std::unordered_map<const FunctionSchema*, Entry> cache;
+  const auto deregistrations = operatorDeregistrations.load(std::memory_order_acquire);
+  const auto& schema = op.schema();
+  auto it = cache.find(&schema);
+  if (it == cache.end()) {
+    it = cache.emplace(&schema, Entry{computeOperatorInfo(schema), deregistrations}).first;
+  } else if (C10_UNLIKELY(it->second.deregistrations != deregistrations)) {
+    auto info = computeOperatorInfo(schema);
+    if (!(info == it->second.info)) {
+      it->second.info = std::move(info);
+    }
+    it->second.deregistrations = deregistrations;
+  }
+  return it->second.info;
+}
+
 static void checkForInvalidMutationOnCaptures(
     const c10::OperatorHandle& op,
+    const OperatorInfo& op_info,
     torch::jit::Stack* stack,
-    const std::vector<DynamicLayer>& dynamicLayerStack) {
+    ArrayRef<DynamicLayer> dynamicLayerStack) {
   if (dynamicLayerStack.back().key() != DispatchKey::Autograd) {
     return;
   }
@@ -434,10 +566,10 @@ static void checkForInvalidMutationOnCaptures(
   if (dynamicLayerStack.size() <= 1) {
     return;
   }
-  if (!isInplaceOp(op.schema())) {
+  if (!op_info.isInplace) {
     return;
   }
-  auto args = torch::jit::last(stack, op.schema().arguments().size());
+  auto args = torch::jit::last(stack, op_info.numArgs);
   auto mutated_arg = unwrapIfDead(args[0].toTensor());
   auto cur_level = dynamicLayerStack.back().layerId();
   auto* wrapper = maybeGetTensorWrapper(mutated_arg);
@@ -493,20 +625,22 @@ void dynamicLayerFrontFallback(const c10::OperatorHandle& op, torch::jit::Stack*
     return;
   }
 
+  const auto& op_info = getOperatorInfo(op);
+
   // if is a grad transform, and the operation is in-place, and the mutated
   // argument is not currently wrapped in a TensorWrapper, then we need to
   // error out otherwise the result is silently incorrect
-  checkForInvalidMutationOnCaptures(op, stack, dynamicLayerStack);
+  checkForInvalidMutationOnCaptures(op, op_info, stack, dynamicLayerStack);
 
   // Unwrap dead GradWrappers, materialize live ones
   auto maybeTransformGradWrappers = [](const Tensor& tensor) {
     auto result = unwrapIfDead(tensor);
     return materializeGradWrappers(result, getDynamicLayerStack());
   };
-  auto num_args = op.schema().arguments().size();
-  foreachTensorInplace(*stack, stack->size() - num_args, stack->size(), maybeTransformGradWrappers);
+  foreachTensorInplaceAt(*stack, stack->size() - op_info.numArgs, op_info.tensorArgs,
+      maybeTransformGradWrappers);
 
-  auto layer = dynamicLayerStack.back();
+  const auto& layer = dynamicLayerStack.back();
 
   DispatchKeySet exclude = keysToExcludeWhenEnteringDynamicLayer(layer.key());
   DispatchKeySet hacky_include;
@@ -514,8 +648,8 @@ void dynamicLayerFrontFallback(const c10::OperatorHandle& op, torch::jit::Stack*
   if (layer.key() == kBatchedKey) {
     // Only enable dispatch on kBatchedKey if there are tensors batched
     // at the current level.
-    const auto args = torch::jit::last(stack, op.schema().arguments().size());
-    if (allTensors(args, notBatchedAtCurrentLevel)) {
+    const auto args = torch::jit::last(stack, op_info.numArgs);
+    if (allTensors(args, op_info.tensorArgs, notBatchedAtCurrentLevel)) {
       exclude = exclude.add(kBatchedKey);
     }
     hacky_include = hacky_include.add(kVmapModeKey);
@@ -558,10 +692,11 @@ struct SaveLocalDispatchKeySet {
 };
 
 void dynamicLayerBackFallback(const c10::OperatorHandle& op, torch::jit::Stack* stack) {
-  auto cur_level = getDynamicLayerStack().back().layerId();
-  auto cur_key = getDynamicLayerStack().back().key();
+  const auto& cur_layer = dynamicLayerStackAccessor().back();
+  auto cur_level = cur_layer.layerId();
+  auto cur_key = cur_layer.key();
 
-  optional<bool> prev_grad_mode = getDynamicLayerStack().back().prevGradMode();
+  optional<bool> prev_grad_mode = cur_layer.prevGradMode();
   if (cur_key == DispatchKey::Autograd) {
     TORCH_INTERNAL_ASSERT(prev_grad_mode.has_value());
   }
@@ -594,8 +729,6 @@ void dynamicLayerBackFallback(const c10::OperatorHandle& op, torch::jit::Stack*
     return makeTensorWrapper(tensor, cur_level);
   };
 
-  // TODO: we only need to do the following (marked with !) on in-place functions
-  // that modify sizes or strides. There aren't many of them.
   // If autograd dispatch key:
   // 1. (!) Put a copy of all of the args onto the stack
   // 2. Unwrap all the args in the copy set
@@ -603,17 +736,25 @@ void dynamicLayerBackFallback(const c10::OperatorHandle& op, torch::jit::Stack*
   // 4. Wrap the output
   // 5. (!) refreshMetadata for all the args in the original set
   // 6. (!) Pop those args off.
+  // The steps marked with (!) are only needed for operators that mutate
+  // their arguments, which may change their sizes or strides. Other
+  // operators unwrap their args in place.
+  const auto& op_info = getOperatorInfo(op);
+  const bool keep_original_args = cur_key == DispatchKey::Autograd &&
+      op_info.mutatesArguments;
 
   // Step 1 & 2
   if (cur_key == DispatchKey::Autograd) {
-    auto args_size = op.schema().arguments().size();
+    auto args_size = op_info.numArgs;
     // Step 1
-    auto front = stack->size() - args_size;
-    for (const auto arg_idx : c10::irange(0, args_size)) {
-      stack->push_back((*stack)[front + arg_idx]);
+    if (keep_original_args) {
+      auto front = stack->size() - args_size;
+      for (const auto arg_idx : c10::irange(0, args_size)) {
+        stack->push_back((*stack)[front + arg_idx]);
+      }
     }
     // Step 2
-    foreachTensorInplace(*stack, stack->size() - args_size, stack->size(), unwrap);
+    foreachTensorInplaceAt(*stack, stack->size() - args_size, op_info.tensorArgs, unwrap);
   }
 
   // pop the top layer. Put it back on dtor.
@@ -645,13 +786,16 @@ void dynamicLayerBackFallback(const c10::OperatorHandle& op, torch::jit::Stack*
   // Step 4, 5, 6
   if (cur_key == DispatchKey::Autograd) {
     // Step 4
-    auto ret_size = op.schema().returns().size();
-    foreachTensorInplace(*stack, stack->size() - ret_size, stack->size(), wrap);
+    auto ret_size = op_info.numReturns;
+    foreachTensorInplaceAt(*stack, stack->size() - ret_size, op_info.tensorReturns, wrap);
+    if (!keep_original_args) {
+      return;
+    }
 
     // Step 5
-    auto args_size = op.schema().arguments().size();
+    auto args_size = op_info.numArgs;
     auto args_front = stack->size() - args_size - ret_size;
-    for (const auto arg_idx : c10::irange(0, args_size)) {
+    for (const auto arg_idx : op_info.tensorArgs) {
       auto& ivalue = (*stack)[args_front + arg_idx];
       if (!ivalue.isTensor()) {
         continue;
@@ -8,6 +8,7 @@
 #include <c10/core/DispatchKey.h>
 #include <ATen/core/function_schema.h>
 #include <c10/util/Optional.h>
+#include <c10/util/ArrayRef.h>
 #include <unordered_map>
 #include <mutex>
 
@@ -32,6 +33,9 @@ struct TORCH_API DynamicLayer {
       optional<RandomnessType> randomness = nullopt,
       optional<bool> prev_grad_mode = nullopt);
 
+  // An undefined layer, for the unused slots of the DynamicLayer stack.
+  DynamicLayer();
+
   DispatchKey key() const;
   int64_t layerId() const;
 
@@ -42,16 +46,30 @@ struct TORCH_API DynamicLayer {
   // only valid for grad-based transforms
   optional<bool> prevGradMode() const;
  private:
+  struct VmapMetadata {
+    int64_t batchSize;
+    RandomnessType randomness;
+  };
+
   DispatchKey key_;
   int64_t layerId_;
 
-  // Honestly these should be a union or some extendable metadata class.
-  // Not doing that for now because I don't think we'll use this mechanism for very long.
-  optional<int64_t> batchSize_;
-  optional<RandomnessType> randomness_;
-  optional<bool> prevGradMode_;
+  // Metadata of the transform, which depends on key_: the batch size and
+  // randomness of vmap layers, or the grad mode from before grad layers.
+  union {
+    VmapMetadata vmap_;
+    bool prevGradMode_;
+  };
 };
 
+// Maximum number of layers on the DynamicLayer stack, including the initial
+// autograd layer. Layer ids go from 1 to kMaxDynamicLayers, which keeps them
+// below kVmapNumLevels.
+constexpr int64_t kMaxDynamicLayers = 63;
+
+// Generation of wrappers that were never alive; see getGenerationForLevel.
+constexpr uint64_t kDeadGeneration = 0;
+
 TORCH_API int64_t initAndPushDynamicLayer(
     DispatchKey key,
     optional<int64_t> batch_size = nullopt,
@@ -59,16 +77,20 @@ TORCH_API int64_t initAndPushDynamicLayer(
     optional<bool> prev_grad_mode = nullopt);
 TORCH_API DynamicLayer popDynamicLayerAndDeleteMetadata();
 TORCH_API c10::optional<DynamicLayer> maybeCurrentDynamicLayer();
-TORCH_API const std::vector<DynamicLayer>& getDynamicLayerStack();
-TORCH_API void setDynamicLayerStack(const std::vector<DynamicLayer>& stack);
+TORCH_API ArrayRef<DynamicLayer> getDynamicLayerStack();
+TORCH_API void setDynamicLayerStack(ArrayRef<DynamicLayer> stack);
 TORCH_API void setDynamicLayerFrontBackKeysIncluded(bool included);
 
-// NB: Not lock safe, you should only call this from Python where the GIL will
-// prevent race conditions.
+// Whether any transform is active on the current thread.
 TORCH_API bool areTransformsActive();
 
-// NB: not lock safe. TODO: does it need a lock?
-TORCH_API std::shared_ptr<bool> getLifeHandleForLevel(int64_t level);
+// Returns the generation of a level that is on the DynamicLayer stack. Each
+// transform pushed at a level starts a new generation, and wrappers created
+// by it are alive while isLevelAlive(level, generation).
+// NB: levels are per thread, like the DynamicLayer stack, and generations are
+// unique across threads, so transforms can run on several threads at once.
+TORCH_API uint64_t getGenerationForLevel(int64_t level);
+TORCH_API bool isLevelAlive(int64_t level, uint64_t generation);
 
 // Returns if an operator is in-place. An operator is inplace if:
 // 1. The first argument is a Tensor and it is being written to
@@ -78,15 +100,69 @@ TORCH_API std::shared_ptr<bool> getLifeHandleForLevel(int64_t level);
 // add_(Tensor(a!) self, Tensor other, *, Scalar alpha=1) -> Tensor(a!)
 bool isInplaceOp(const c10::FunctionSchema& schema);
 
+// Applies func to the Tensors in ivalue, which may be a Tensor, a Tensor[]
+// or a Tensor?[]. A Tensor?[] is only copied if func replaces one of its
+// Tensors, since the list may be shared with the caller.
+template <typename Func>
+void transformTensorsInplace(IValue& ivalue, Func&& func) {
+  // Tensor?[] translates to a c10::List<IValue> so we need to peek inside List
+  if (ivalue.isList()) {
+    const auto list = ivalue.toList();
+    c10::optional<c10::List<IValue>> modified;
+    for (size_t list_idx = 0; list_idx < list.size(); list_idx++) {
+      const auto elt = list.get(list_idx);
+      if (!elt.isTensor()) {
+        continue;
+      }
+      Tensor replacement = func(elt.toTensor());
+      if (!modified) {
+        if (replacement.is_same(elt.toTensor())) {
+          continue;
+        }
+        modified = list.copy();
+      }
+      modified->set(list_idx, std::move(replacement));
+    }
+    if (modified) {
+      ivalue = std::move(*modified);
+    }
+    return;
+  }
+  if (ivalue.isTensorList()) {
+    auto list = ivalue.toTensorList();
+    for (size_t list_idx = 0; list_idx < list.size(); list_idx++) {
+      list[list_idx] = func(list[list_idx]);
+    }
+    return;
+  }
+  TORCH_INTERNAL_ASSERT(!ivalue.isGenericDict(), "No operators can accept GenericDict");
+  if (!ivalue.isTensor()) {
+    return;
+  }
+  Tensor replacement = func(ivalue.toTensor());
+  // sanity checks
+  if (ivalue.toTensor().defined()) {
+    TORCH_INTERNAL_ASSERT(replacement.defined());
+  }
+  ivalue = std::move(replacement);
+}
+
 // Applies the following for-loop:
 // for i in range(begin, end):
 //   args[i] = func(args[i])
-void foreachTensorInplace(std::vector<IValue>& args, int64_t begin, int64_t end,
-    std::function<Tensor(const Tensor&)> func);
+template <typename Func>
+void foreachTensorInplace(std::vector<IValue>& args, int64_t begin, int64_t end, Func&& func) {
+  TORCH_INTERNAL_ASSERT(begin >= 0);
+  TORCH_INTERNAL_ASSERT(end >= 0);
+  TORCH_INTERNAL_ASSERT(begin <= end);
+  for (int64_t idx = begin; idx < end; idx++) {
+    transformTensorsInplace(args[idx], func);
+  }
+}
 
 // Pretty printers
 std::ostream& operator<<(std::ostream& os, const DynamicLayer& layer);
-std::ostream& operator<<(std::ostream& os, const std::vector<DynamicLayer>& dynamicLayerStack);
+std::ostream& operator<<(std::ostream& os, ArrayRef<DynamicLayer> dynamicLayerStack);
 
 }
 } // namespace at
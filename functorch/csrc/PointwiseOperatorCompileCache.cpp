@@ -25,8 +25,8 @@
 ///   --is a---> InOutSpecializedCache<NUM_IN, NUM_OUT>
 ///   --has a--> ArgCountSpecializedCache<ArgCounts>
 ///   --has a--> ArgAndDimSpecializedCache<ArgCounts, MAX_DIMS>
-///   --has a--> map<SpecializationKey<MAX_DIMS>,
-///                  PointwiseOperatorCompileResult<ArgCounts, MAX_DIMS>>
+///   --has a--> hash table<SpecializationKey<MAX_DIMS>[numKeys],
+///                         PointwiseOperatorCompileResult<ArgCounts, MAX_DIMS>>
 ///
 /// With this structure, a SpecializationKey and PointwiseOperatorCompileResult
 /// know exactly how many arguments and dimensions they have to deal with, so a
@@ -34,12 +34,34 @@
 /// traversing dynamically allocated structures. This saves precious cycles in
 /// figuring out which kernel to launch!.
 ///
+/// Kernels with tensors of more than 8 dims, or with more than 8 inputs, fall
+/// back to DynamicArgCache (through DynamicInOutCache for the latter), which
+/// keys on heap-allocated DynamicSpecializationKeys instead.
+///
+/// Before looking up the kernel, adjacent dims that can be iterated over as
+/// one in every argument are collapsed (see collapseDims), so differently
+/// shaped but equally laid out calls share kernels.
+///
+/// Kernels can also be compiled ahead of time, from example calls
+/// (pyPrecompile), so that the first real call with those properties hits the
+/// cache.  Precompiling publishes kernels the same way a miss does.  Keys hold
+/// everything needed to compile a kernel, so the cached keys can be listed
+/// (cachedKernels), saved, and compiled again later (precompileRecord).
+///
 #include <functorch/csrc/PointwiseOperatorCompileCache.h>
+#include <ATen/record_function.h>
+#include <torch/csrc/Dtype.h>
+#include <torch/csrc/DynamicTypes.h>
 #include <torch/csrc/autograd/custom_function.h>
 #include <torch/csrc/jit/python/pybind_utils.h>
 #include <torch/csrc/jit/tensorexpr/codegen.h>
 #include <torch/csrc/utils/pybind.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+
 using namespace torch::jit::tensorexpr;
 
 namespace {
@@ -68,6 +90,144 @@ static uint8_t packFlags(const LocalState &state, const at::Tensor &v) {
          (static_cast<uint8_t>(dtype) << 1);
 }
 
+/// Finalizer of splitmix64, scrambles all bits of x.
+static inline uint64_t mixBits(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+/// Hash a buffer of raw bytes, mixing in 8 bytes at a time.
+static inline uint64_t hashBytes(const void *data, size_t len) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  uint64_t hash = 0x9e3779b97f4a7c15ULL ^ len;
+  for (; len >= 8; bytes += 8, len -= 8) {
+    uint64_t chunk;
+    memcpy(&chunk, bytes, 8);
+    hash = mixBits(hash ^ chunk);
+  }
+  if (len > 0) {
+    uint64_t chunk = 0;
+    memcpy(&chunk, bytes, len);
+    hash = mixBits(hash ^ chunk);
+  }
+  return hash;
+}
+
+/// Flag bits indicating tensor shape properties like contiguity and
+/// broadcasting that are relevant for codegen.
+enum DimFlags {
+  /// A leading dimension implicitly added by broadcasting.
+  SIZE_MISSING = 1 << 0,
+
+  /// Size == 1.
+  SIZE_ONE = 1 << 1,
+
+  /// Size > 1.
+  SIZE_OTHER = 1 << 2,
+
+  /// Stride == 0; broadcasting.
+  STRIDE_ZERO = 1 << 3,
+
+  /// Stride == 1; packed contiguously in memory.
+  STRIDE_ONE = 1 << 4,
+
+  /// Stride = Stride[i + 1] * Size[i + 1].
+  /// Used to collapse dimensions.
+  STRIDE_CONTIGUOUS = 1 << 5,
+
+  /// Stride = Stride[i - 1] * Size[i - 1].
+  /// Used to collapse dimensions in the other direction.
+  STRIDE_TRANSPOSED_CONTIGUOUS = 1 << 6, // stride[i-1] * sizes[i-1]
+
+  /// Stride must be provided as an argument.
+  STRIDE_AS_ARG = 1 << 7,
+};
+
+/// Compute the shape flags of dimension dim, given the flags of the previous
+/// dimension.
+static uint8_t computeDimflag(c10::IntArrayRef sizes, c10::IntArrayRef strides,
+                              int64_t dim, uint8_t prevFlag) {
+  uint8_t flag = (sizes[dim] == 1 ? SIZE_ONE : SIZE_OTHER);
+  if (strides[dim] == 0) {
+    flag |= STRIDE_ZERO;
+  } else if (strides[dim] == 1) {
+    flag |= STRIDE_ONE;
+  } else if (dim + 1 < (int64_t)sizes.size() &&
+             strides[dim] == strides[dim + 1] * sizes[dim + 1]) {
+    flag |= STRIDE_CONTIGUOUS;
+  } else if (dim > 0 && strides[dim] == strides[dim - 1] * sizes[dim - 1] &&
+             (prevFlag & STRIDE_CONTIGUOUS) == 0) {
+    flag |= STRIDE_TRANSPOSED_CONTIGUOUS;
+  } else {
+    flag |= STRIDE_AS_ARG;
+  }
+  return flag;
+}
+
+/// Convert a specialization key to a python namedtuple. flags is packed by
+/// packFlags, and dimflags holds the shape flags of (at most) ndims
+/// dimensions.  Only uses the key, so kernels can be compiled for keys
+/// without example tensors.
+static py::object specializationKeyToPython(uint8_t flags, int8_t aliasGroup,
+                                            at::DispatchKeySet dispatchKey,
+                                            const uint8_t *dimflags,
+                                            int ndims, bool is_out) {
+  // Create the python specialization key type (a namedtuple) lazily.
+  static py::object keyType = [] {
+    // create it lazily
+    py::object namedtuple =
+        py::module_::import("collections").attr("namedtuple");
+    return namedtuple("SpecializationKey",
+                      "alias_group,ndim,dtype,device,layout,requires_grad,"
+                      "out,shape,stride");
+  }();
+  std::vector<std::string> shape;
+  std::vector<std::string> stride;
+  for (int i = 0; i < ndims; ++i) {
+    if ((dimflags[i] & SIZE_MISSING) > 0) {
+      break;
+    }
+
+    if ((dimflags[i] & SIZE_ONE) > 0) {
+      shape.emplace_back("one");
+    } else {
+      shape.emplace_back("other");
+    }
+
+    if ((dimflags[i] & STRIDE_ZERO) > 0) {
+      stride.emplace_back("zero");
+    } else if ((dimflags[i] & STRIDE_ONE) > 0) {
+      stride.emplace_back("one");
+    } else if ((dimflags[i] & STRIDE_CONTIGUOUS) > 0) {
+      stride.emplace_back("contiguous");
+    } else if ((dimflags[i] & STRIDE_TRANSPOSED_CONTIGUOUS) > 0) {
+      stride.emplace_back("transposed_contiguous");
+    } else if ((dimflags[i] & STRIDE_AS_ARG) > 0) {
+      stride.emplace_back("as_arg");
+    } else {
+      TORCH_INTERNAL_ASSERT(false, "unknown stride properties");
+    }
+  }
+  const int dtype = flags >> 1;
+  TORCH_CHECK(dtype < static_cast<int>(at::ScalarType::NumOptions),
+              "malformed specialization key");
+  py::handle dtypeObject(reinterpret_cast<PyObject *>(
+      torch::getTHPDtype(static_cast<at::ScalarType>(dtype))));
+  py::handle layoutObject(
+      reinterpret_cast<PyObject *>(torch::getTHPLayout(at::Layout::Strided)));
+  // Kernels only support dense CPU and CUDA tensors (see checkDispatchKeys).
+  at::Device device(dispatchKey.has(at::DispatchKey::CUDA)
+                        ? at::DeviceType::CUDA
+                        : at::DeviceType::CPU);
+  return keyType(static_cast<int>(aliasGroup), shape.size(), dtypeObject,
+                 py::cast(device), layoutObject, py::bool_(flags & 1),
+                 py::bool_(is_out), shape, stride);
+}
+
 /// Per-tensor cache specialization key, templated on the number of
 /// tensor dims.  Records dtype, dispatch options, aliasing, and
 /// per-dim contiguity/broadcasting information.
@@ -87,132 +247,26 @@ template <int MAX_DIMS> struct SpecializationKey {
     initDimflags(v.sizes(), v.strides(), v.ndimension());
   }
 
-  /// Compare key to other and return 0 if equal, <0 if key is less
-  /// than other, or >0 if key is greater than other.
-  bool operator<(const SpecializationKey<MAX_DIMS> &other) const {
-    static_assert(sizeof(SpecializationKey<MAX_DIMS>) == 10 + MAX_DIMS,
-                  "struct is not packed, memcmp requires no padding");
-    return memcmp(this, &other, sizeof(SpecializationKey<MAX_DIMS>)) < 0;
-  }
-
   /// Get the dispatch key for this specialization.
   at::DispatchKeySet dispatchKey() const {
     return at::DispatchKeySet(at::DispatchKeySet::RAW, dispatchKey_);
   }
 
-  /// Return vector of strings describing key sizes.
-  std::vector<std::string> shape() const {
-    std::vector<std::string> result;
-    for (int i = 0; i < MAX_DIMS; ++i) {
-      if ((dimflags_[i] & SIZE_MISSING) > 0) {
-        break;
-      }
-
-      if ((dimflags_[i] & SIZE_ONE) > 0) {
-        result.emplace_back("one");
-      } else {
-        result.emplace_back("other");
-      }
-    }
-    return result;
-  }
-
-  /// Return vector of strings describing key strides.
-  std::vector<std::string> stride() const {
-    std::vector<std::string> result;
-    for (int i = 0; i < MAX_DIMS; ++i) {
-      if ((dimflags_[i] & SIZE_MISSING) > 0) {
-        break;
-      }
-
-      if ((dimflags_[i] & STRIDE_ZERO) > 0) {
-        result.emplace_back("zero");
-      } else if ((dimflags_[i] & STRIDE_ONE) > 0) {
-        result.emplace_back("one");
-      } else if ((dimflags_[i] & STRIDE_CONTIGUOUS) > 0) {
-        result.emplace_back("contiguous");
-      } else if ((dimflags_[i] & STRIDE_TRANSPOSED_CONTIGUOUS) > 0) {
-        result.emplace_back("transposed_contiguous");
-      } else if ((dimflags_[i] & STRIDE_AS_ARG) > 0) {
-        result.emplace_back("as_arg");
-      } else {
-        TORCH_INTERNAL_ASSERT(false, "unknown stride properties");
-      }
-    }
-    return result;
-  }
-
   /// Convert this specialization key to a python namedtuple.
-  py::object toPython(const at::Tensor &example, bool is_out) const {
-    // Create the python specialization key type (a namedtuple) lazily.
-    static py::object keyType = [] {
-      // create it lazily
-      py::object namedtuple =
-          py::module_::import("collections").attr("namedtuple");
-      return namedtuple("SpecializationKey",
-                        "alias_group,ndim,dtype,device,layout,requires_grad,"
-                        "out,shape,stride");
-    }();
-    py::object ex = py::cast(example);
-    return keyType(static_cast<int>(aliasGroup_), ex.attr("ndim"),
-                   ex.attr("dtype"), ex.attr("device"), ex.attr("layout"),
-                   ex.attr("requires_grad"), py::bool_(is_out), shape(),
-                   stride());
+  py::object toPython(bool is_out) const {
+    return specializationKeyToPython(flags_, aliasGroup_, dispatchKey(),
+                                     dimflags_, MAX_DIMS, is_out);
   }
 
 private:
-  /// Flag bits indicating tensor shape properties like contiguity and
-  /// broadcasting that are relevant for codegen.
-  enum DimFlags {
-    /// A leading dimension implicitly added by broadcasting.
-    SIZE_MISSING = 1 << 0,
-
-    /// Size == 1.
-    SIZE_ONE = 1 << 1,
-
-    /// Size > 1.
-    SIZE_OTHER = 1 << 2,
-
-    /// Stride == 0; broadcasting.
-    STRIDE_ZERO = 1 << 3,
-
-    /// Stride == 1; packed contiguously in memory.
-    STRIDE_ONE = 1 << 4,
-
-    /// Stride = Stride[i + 1] * Size[i + 1].
-    /// Used to collapse dimensions.
-    STRIDE_CONTIGUOUS = 1 << 5,
-
-    /// Stride = Stride[i - 1] * Size[i - 1].
-    /// Used to collapse dimensions in the other direction.
-    STRIDE_TRANSPOSED_CONTIGUOUS = 1 << 6, // stride[i-1] * sizes[i-1]
-
-    /// Stride must be provided as an argument.
-    STRIDE_AS_ARG = 1 << 7,
-  };
-
   /// Initialize the shape flags for each dimension.
   void initDimflags(c10::IntArrayRef sizes, c10::IntArrayRef strides,
                     int64_t ndims) {
     // Pack all the properties for each dimension into a uint8.
     for (int64_t dim = 0; dim < MAX_DIMS; ++dim) {
       if (dim < ndims) {
-        uint8_t flag = (sizes[dim] == 1 ? SIZE_ONE : SIZE_OTHER);
-        if (strides[dim] == 0) {
-          flag |= STRIDE_ZERO;
-        } else if (strides[dim] == 1) {
-          flag |= STRIDE_ONE;
-        } else if (dim + 1 < (int64_t)sizes.size() &&
-                   strides[dim] == strides[dim + 1] * sizes[dim + 1]) {
-          flag |= STRIDE_CONTIGUOUS;
-        } else if (dim > 0 &&
-                   strides[dim] == strides[dim - 1] * sizes[dim - 1] &&
-                   (dimflags_[dim - 1] & STRIDE_CONTIGUOUS) == 0) {
-          flag |= STRIDE_TRANSPOSED_CONTIGUOUS;
-        } else {
-          flag |= STRIDE_AS_ARG;
-        }
-        dimflags_[dim] = flag;
+        dimflags_[dim] = computeDimflag(sizes, strides, dim,
+                                        dim > 0 ? dimflags_[dim - 1] : 0);
       } else {
         dimflags_[dim] = SIZE_MISSING | STRIDE_ZERO;
       }
@@ -238,6 +292,104 @@ private:
 };
 #pragma pack(pop)
 
+/// Specialization key for any number of tensors of any rank, used above the
+/// limits of the fixed-size caches. Holds the same information as an array
+/// of SpecializationKey, serialized into a heap-allocated byte string.
+struct DynamicSpecializationKey {
+  /// Size of the fixed part of each tensor's entry: flags, alias group,
+  /// dispatch key and ndims.
+  static constexpr size_t kHeaderSize = 1 + 1 + sizeof(uint64_t) + 1;
+
+  DynamicSpecializationKey(const LocalState &state, const at::Tensor *args,
+                           const int8_t *aliasGroups, int numKeys) {
+    for (int i = 0; i < numKeys; ++i) {
+      const at::Tensor &v = args[i];
+      int64_t ndims = v.dim();
+      TORCH_CHECK(ndims < 256, "pointwise operators support at most 255 dims");
+      uint8_t header[kHeaderSize];
+      uint64_t dispatchKey = state.apply(v.key_set()).raw_repr();
+      header[0] = packFlags(state, v);
+      header[1] = static_cast<uint8_t>(aliasGroups[i]);
+      memcpy(header + 2, &dispatchKey, sizeof(uint64_t));
+      header[kHeaderSize - 1] = static_cast<uint8_t>(ndims);
+      offsets_.push_back(bytes_.size());
+      bytes_.append(reinterpret_cast<const char *>(header), kHeaderSize);
+      uint8_t prevFlag = 0;
+      for (int64_t dim = 0; dim < ndims; ++dim) {
+        prevFlag = computeDimflag(v.sizes(), v.strides(), dim, prevFlag);
+        bytes_.push_back(static_cast<char>(prevFlag));
+      }
+    }
+  }
+
+  /// Construct a key for numKeys tensors from its serialized bytes, as
+  /// returned by bytes().
+  DynamicSpecializationKey(std::string bytes, int numKeys)
+      : bytes_(std::move(bytes)) {
+    size_t offset = 0;
+    for (int i = 0; i < numKeys; ++i) {
+      TORCH_CHECK(offset + kHeaderSize <= bytes_.size(),
+                  "malformed specialization key");
+      offsets_.push_back(offset);
+      offset += kHeaderSize +
+                static_cast<uint8_t>(bytes_[offset + kHeaderSize - 1]);
+    }
+    TORCH_CHECK(offset == bytes_.size(), "malformed specialization key");
+  }
+
+  bool operator==(const DynamicSpecializationKey &other) const {
+    return bytes_ == other.bytes_;
+  }
+
+  size_t hash() const { return std::hash<std::string>()(bytes_); }
+
+  /// Get the combined dispatch keys of all tensors.
+  at::DispatchKeySet dispatchKeys() const {
+    at::DispatchKeySet ks;
+    for (size_t offset : offsets_) {
+      uint64_t raw;
+      memcpy(&raw, bytes_.data() + offset + 2, sizeof(uint64_t));
+      ks = ks | at::DispatchKeySet(at::DispatchKeySet::RAW, raw);
+    }
+    return ks;
+  }
+
+  /// Get the max number of dims of all tensors.
+  int maxDims() const {
+    int maxDims = 0;
+    for (size_t offset : offsets_) {
+      maxDims = std::max<int>(maxDims, static_cast<uint8_t>(
+                                           bytes_[offset + kHeaderSize - 1]));
+    }
+    return maxDims;
+  }
+
+  /// Get the serialized key.
+  const std::string &bytes() const { return bytes_; }
+
+  /// Convert the key of tensor i to a python namedtuple.
+  py::object toPython(int i, bool is_out) const {
+    const auto *entry =
+        reinterpret_cast<const uint8_t *>(bytes_.data() + offsets_[i]);
+    uint64_t dispatchKey;
+    memcpy(&dispatchKey, entry + 2, sizeof(uint64_t));
+    return specializationKeyToPython(
+        entry[0], static_cast<int8_t>(entry[1]),
+        at::DispatchKeySet(at::DispatchKeySet::RAW, dispatchKey),
+        entry + kHeaderSize, entry[kHeaderSize - 1], is_out);
+  }
+
+  struct Hash {
+    size_t operator()(const DynamicSpecializationKey &key) const {
+      return key.hash();
+    }
+  };
+
+private:
+  std::string bytes_;
+  std::vector<size_t> offsets_;
+};
+
 /// Compiled kernel interface, used to set up kernel properties from
 /// python.  Implemented by template-specialized subclasses.
 struct PointwiseOperatorCompileResultBase {
@@ -247,6 +399,10 @@ struct PointwiseOperatorCompileResultBase {
   /// Set contained code to cg.
   virtual void setCode(const py::object &cg) = 0;
 
+  /// Set the summary of the specialization key, recorded as an input of the
+  /// profiler events of calls.
+  virtual void setSpecSummary(std::string summary) = 0;
+
   /// Set vector of (arg, dim) pairs that indicate from which argument/dimension
   /// to extract the output size.
   virtual void
@@ -258,14 +414,23 @@ struct PointwiseOperatorCompileResultBase {
   setStrideArgsFrom(const std::vector<std::pair<int, int>> &indices) = 0;
 
   /// Add an output for this kernel with the associated options and storage
-  /// order.
-  virtual void addAllocatedOutput(int options_from,
-                                  const std::vector<int> &storage_order) = 0;
+  /// order, which lists the dims of the output, innermost first.  Reduction
+  /// outputs leave out the reduced (trailing) dims.  If given, the kernel
+  /// writes the output in dtype, and it is then converted to resultDtype.
+  virtual void
+  addAllocatedOutput(int options_from, const std::vector<int> &storage_order,
+                     c10::optional<at::ScalarType> dtype,
+                     c10::optional<at::ScalarType> resultDtype) = 0;
 
   /// Add a shape-checking constraint on the inputs.
   virtual void addShapeCheck(const std::tuple<int, int, int, int> &indices) = 0;
 
-  virtual void set_backwards(int index, py::object backward_compiler) = 0;
+  /// Set the backward kernel, which reads the inputs savedInputs, the grad
+  /// of the output and the numScalars scalar args of the forward call, and
+  /// computes the grads of the inputs gradInputs.
+  virtual void set_backwards(const std::vector<int> &gradInputs,
+                             const std::vector<int> &savedInputs,
+                             py::object backward_compiler, int numScalars) = 0;
 };
 
 /// Proxy object to bind compilation results to python.
@@ -277,7 +442,36 @@ struct PoinwiseOperatorCompileResultProxy {
 };
 
 struct PointwiseOperatorCompileCache;
-using CompileCacheBackwards = std::tuple<int, PointwiseOperatorCompileCache *>;
+
+/// Values of the scalar (non-tensor) arguments of a kernel call that are
+/// passed to the kernel as parameters, rather than specialized on. Each slot
+/// holds the bits of a double or an int64_t, matching the parameter type.
+struct ScalarArgs {
+  /// Max number of scalar arguments.
+  static constexpr int kMax = 8;
+
+  ScalarArgs() : size(0) {}
+
+  // NOLINTNEXTLINE: C-style arrays
+  int64_t slots[kMax];
+  int size;
+};
+
+/// Backward pass of a compiled kernel: a single kernel computing the grads of
+/// all inputs that require grad in one pass over memory.
+struct CompiledBackward {
+  /// Inputs to compute grads for, in the order the kernel outputs them.
+  std::vector<int> gradInputs;
+
+  /// Inputs the kernel reads, in order. The grad of the output follows them,
+  /// then the scalar args of the forward call.
+  std::vector<int> savedInputs;
+
+  /// The backward kernel, kept alive by the forward compile result.  For
+  /// backward kernels with scalar args, the cache of the overload taking
+  /// them, resolved when set up so calls need not take the GIL.
+  PointwiseOperatorCompileCache *kernel;
+};
 
 /// Cached compiled code for kernel backward pass.
 class CompiledAutoGradNode : public torch::autograd::Node {
@@ -289,27 +483,31 @@ public:
 
   void release_variables() override { inputs_.clear(); }
 
-  void setup(std::vector<CompileCacheBackwards> &backwards, at::Tensor *args,
-             size_t len) {
-    inputs_.reserve(len);
-    for (size_t i = 0; i < len; ++i) {
+  void setup(std::shared_ptr<const CompiledBackward> backward,
+             at::Tensor *args, const ScalarArgs &scalars) {
+    // Only save the inputs the backward kernel reads.
+    inputs_.reserve(backward->savedInputs.size() + 1);
+    for (int i : backward->savedInputs) {
       inputs_.emplace_back(args[i].detach());
     }
 
     // node outputs
-    backwards_functions_.reserve(backwards.size());
     torch::autograd::edge_list next_edges;
-    for (auto &item : backwards) {
-      backwards_functions_.emplace_back(item);
-      next_edges.emplace_back(
-          torch::autograd::impl::gradient_edge(args[std::get<0>(item)]));
+    next_edges.reserve(backward->gradInputs.size());
+    for (int i : backward->gradInputs) {
+      next_edges.emplace_back(torch::autograd::impl::gradient_edge(args[i]));
     }
     set_next_edges(std::move(next_edges));
+    backward_ = std::move(backward);
+    scalars_ = scalars;
   }
 
 private:
-  std::vector<CompileCacheBackwards> backwards_functions_;
+  std::shared_ptr<const CompiledBackward> backward_;
   std::vector<at::Tensor> inputs_;
+
+  /// Scalar args of the forward call, passed on to the backward kernel.
+  ScalarArgs scalars_;
 };
 
 /// Metaprogramming struct containing the number of arguments to a
@@ -324,11 +522,180 @@ template <int NumIn, int NumOutAllocated, int NumOutGiven> struct ArgCounts {
   static constexpr int numBuffers = NumIn + NumOutAllocated + NumOutGiven;
 };
 
-/// Template container for a compiled kernel, specialized on the count
-/// of arguments (from specializing ArgCounts) and the maximum number
-/// of tensor dimensions.
-template <typename Counts, int MAX_DIMS>
-struct PointwiseOperatorCompileResult
+/// Measurements deciding whether to release the GIL around a kernel.  The
+/// first kSampledCalls calls holding the GIL, and one in every
+/// kResampleInterval calls after that, release it, timing the kernel and the
+/// release plus reacquire of the GIL.  Other calls release the GIL only if
+/// the kernel is expected to take longer than that, from the moving average
+/// of its time per element.
+///
+/// The GIL time is the minimum over the samples, the cost of an uncontended
+/// handoff.  With other threads running, reacquiring the GIL also waits for
+/// them to give it back, up to the interpreter's switch interval, which is
+/// time those threads get to run rather than overhead of releasing it.
+///
+/// Calls holding the GIL are serialized by it, so counting them does not
+/// contend.  Only uses relaxed atomics: concurrent samples may overwrite each
+/// other, which just makes the measurements noisier.
+class GilReleaseStats {
+public:
+  /// Number of calls to time at first.
+  static constexpr uint32_t kSampledCalls = 32;
+
+  /// After the first kSampledCalls, time one call in this many.
+  static constexpr uint32_t kResampleInterval = 1024;
+
+  /// Count a call holding the GIL, returning whether to time it.  Needs the
+  /// GIL.
+  bool shouldSample() {
+    uint32_t n = calls_.load(std::memory_order_relaxed);
+    calls_.store(n + 1, std::memory_order_relaxed);
+    return n < kSampledCalls || n % kResampleInterval == 0;
+  }
+
+  /// Whether releasing the GIL is expected to pay off for numel elements.
+  bool shouldRelease(size_t numel) const {
+    return numel * nsPerElement_.load(std::memory_order_relaxed) >
+           gilNs_.load(std::memory_order_relaxed);
+  }
+
+  /// Run kernel() with the GIL released, timing it.  Needs the GIL.
+  template <typename Kernel> void sample(size_t numel, const Kernel &kernel) {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point kernelStart;
+    Clock::time_point kernelEnd;
+    {
+      py::gil_scoped_release release;
+      kernelStart = Clock::now();
+      kernel();
+      kernelEnd = Clock::now();
+    }
+    Clock::time_point end = Clock::now();
+    std::chrono::duration<double, std::nano> kernelNs = kernelEnd - kernelStart;
+    std::chrono::duration<double, std::nano> gilNs =
+        (kernelStart - start) + (end - kernelEnd);
+    uint32_t n = samples_.fetch_add(1, std::memory_order_relaxed);
+    update(nsPerElement_, kernelNs.count() / std::max<size_t>(numel, 1), n);
+    if (n == 0 || gilNs.count() < gilNs_.load(std::memory_order_relaxed)) {
+      gilNs_.store(gilNs.count(), std::memory_order_relaxed);
+    }
+  }
+
+  /// Number of timed calls.
+  uint32_t samples() const { return samples_.load(std::memory_order_relaxed); }
+
+  /// Moving average of the kernel time per element, in nanoseconds.
+  double nsPerElement() const {
+    return nsPerElement_.load(std::memory_order_relaxed);
+  }
+
+  /// Minimum time to release and reacquire the GIL, in nanoseconds.
+  double gilReleaseNs() const { return gilNs_.load(std::memory_order_relaxed); }
+
+private:
+  /// Add the nth sample to an exponentially weighted moving average.
+  static void update(std::atomic<double> &average, double sample, uint32_t n) {
+    double previous = average.load(std::memory_order_relaxed);
+    double next = n == 0 ? sample : previous + (sample - previous) / 4;
+    average.store(next, std::memory_order_relaxed);
+  }
+
+  /// Number of calls holding the GIL.
+  std::atomic<uint32_t> calls_{0};
+  std::atomic<uint32_t> samples_{0};
+  std::atomic<double> nsPerElement_{0};
+  std::atomic<double> gilNs_{0};
+};
+
+/// Profiler inputs of a kernel call: the tensor args, skipping an unset out
+/// argument.
+static std::vector<c10::IValue> definedInputs(const at::Tensor *args,
+                                              int numArgs) {
+  std::vector<c10::IValue> inputs;
+  inputs.reserve(numArgs + 1);
+  for (int i = 0; i < numArgs; ++i) {
+    if (args[i].defined()) {
+      inputs.emplace_back(args[i]);
+    }
+  }
+  return inputs;
+}
+
+/// Profiler event of a kernel call recording inputs, not yet begun.  The
+/// kernel launch begins it, after the cache lookup and any compile, so that
+/// the event carries the specialization key summary of the kernel.
+struct PendingCallEvent {
+  at::RecordFunction *guard;
+  const std::string *name;
+  const at::Tensor *tensorArgs;
+  int numArgs;
+};
+
+/// The pending call event of this thread, if any.
+static thread_local PendingCallEvent *pendingCallEvent = nullptr;
+
+/// Begin the pending call event with the tensor args as inputs, followed by
+/// the specialization key summary, if given.
+static void beginPendingCallEvent(const std::string *summary) {
+  PendingCallEvent *event = pendingCallEvent;
+  pendingCallEvent = nullptr;
+  std::vector<c10::IValue> inputs =
+      definedInputs(event->tensorArgs, event->numArgs);
+  if (summary != nullptr) {
+    inputs.emplace_back(*summary);
+  }
+  event->guard->before(event->name->c_str(), std::move(inputs));
+}
+
+/// Counter incremented by many threads at once, e.g. on every call of a
+/// kernel.  Split into shards on separate cache lines, so threads mostly
+/// increment different ones rather than contending on a single line.
+class ShardedCounter {
+public:
+  ShardedCounter() {
+    for (Shard &shard : shards_) {
+      shard.count.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /// Add one, to the shard of this thread.
+  void increment() {
+    shards_[threadShard()].count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /// Sum of the shards.  Relaxed, only read for reporting.
+  uint64_t load() const {
+    uint64_t total = 0;
+    for (const Shard &shard : shards_) {
+      total += shard.count.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+private:
+  static constexpr int kShards = 8;
+
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> count;
+  };
+
+  /// Threads get shards round robin, when they first increment a counter.
+  static int threadShard() {
+    static std::atomic<int> nextShard{0};
+    static thread_local int shard =
+        nextShard.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return shard;
+  }
+
+  // NOLINTNEXTLINE: C-style arrays
+  Shard shards_[kShards];
+};
+
+/// Compiled kernel and the launch logic shared by the fixed-size and dynamic
+/// compile results. The argument counts and max number of dimensions are
+/// passed in by the subclasses, as compile-time constants where possible.
+struct PointwiseOperatorCompileResultImpl
     : public PointwiseOperatorCompileResultBase {
   /// Set contained code to cg.
   void setCode(const py::object &cg) {
@@ -336,10 +703,14 @@ struct PointwiseOperatorCompileResult
     cg_ = cg.cast<CodeGen *>();
   }
 
+  /// Set the summary of the specialization key.
+  void setSpecSummary(std::string summary) {
+    specSummary_ = std::move(summary);
+  }
+
   /// Set vector of (arg, dim) pairs that indicate from which argument/dimension
   /// to extract the output size.
   void setShapeFrom(const std::vector<std::pair<int, int>> &indices) {
-    assert(indices.size() <= MAX_DIMS);
     shapeFrom_ = indices;
   }
 
@@ -350,13 +721,17 @@ struct PointwiseOperatorCompileResult
   }
 
   /// Add an output for this kernel with the associated options and storage
-  /// order.
-  void addAllocatedOutput(int optionsFrom,
-                          const std::vector<int> &storageOrder) {
-    if (allocatedOutputs_.size() > 0) {
-      throw std::runtime_error("TODO: support more than one output");
-    }
-    allocatedOutputs_.emplace_back(std::make_pair(optionsFrom, storageOrder));
+  /// order, written in dtype and converted to resultDtype, if given.
+  void addAllocatedOutput(int optionsFrom, const std::vector<int> &storageOrder,
+                          c10::optional<at::ScalarType> dtype,
+                          c10::optional<at::ScalarType> resultDtype) {
+    AllocatedOutput output;
+    output.optionsFrom = optionsFrom;
+    output.storageOrder = storageOrder;
+    output.dtype = dtype;
+    output.resultDtype = resultDtype;
+    allocatedOutputs_.emplace_back(std::move(output));
+    convertOutputs_ = convertOutputs_ || resultDtype.has_value();
   }
 
   /// Add a shape-checking constraint on the inputs.
@@ -364,14 +739,35 @@ struct PointwiseOperatorCompileResult
     shapeChecks_.emplace_back(indices);
   }
 
-  void set_backwards(int index, py::object backward_compiler) override {
-    objects_.emplace_back(backward_compiler);
-    backwards_functions_.emplace_back(std::make_tuple(
-        index, backward_compiler.cast<PointwiseOperatorCompileCache *>()));
-  }
+  void set_backwards(const std::vector<int> &gradInputs,
+                     const std::vector<int> &savedInputs,
+                     py::object backward_compiler, int numScalars) override;
 
-  /// Call the cached kernel with the provided args.
-  void call(at::Tensor *args) {
+  /// Count a cache lookup that found this kernel.
+  void recordHit() { hits_.increment(); }
+
+  /// Number of cache lookups that found this kernel.
+  uint64_t hits() const { return hits_.load(); }
+
+  /// Record the time it took to compile this kernel, in seconds.
+  void setCompileTime(double seconds) { compileTime_ = seconds; }
+
+  /// Time it took to compile this kernel, in seconds.
+  double compileTime() const { return compileTime_; }
+
+  /// Timings deciding whether calls release the GIL.
+  const GilReleaseStats &gilStats() const { return gilStats_; }
+
+protected:
+  /// Call the cached kernel with the provided args. callArgs must have room
+  /// for numBuffers + (numKeys + 1) * maxDims + scalars.size pointers, shapes
+  /// and strides for maxDims values.
+  void launch(at::Tensor *args, const ScalarArgs &scalars, int numIn,
+              int numKeys, int numOutAllocated, int numOut, void **callArgs,
+              int64_t *shapes, int64_t *strides) {
+    if (C10_UNLIKELY(pendingCallEvent != nullptr)) {
+      beginPendingCallEvent(&specSummary_);
+    }
     for (const auto &ck : shapeChecks_) {
       if (args[std::get<0>(ck)].size(std::get<1>(ck)) !=
           args[std::get<2>(ck)].size(std::get<3>(ck))) {
@@ -381,15 +777,12 @@ struct PointwiseOperatorCompileResult
       }
     }
 
-    // NOLINTNEXTLINE: C-style arrays
-    void *callArgs[Counts::numBuffers + (Counts::numKeys + 1) * MAX_DIMS];
-    constexpr int allocatedArgsOffset = Counts::numKeys;
+    const int allocatedArgsOffset = numKeys;
     for (int i = 0; i < allocatedArgsOffset; ++i) {
       callArgs[i] = args[i].data_ptr();
     }
 
-    constexpr int strideArgsOffset =
-        allocatedArgsOffset + Counts::numOutAllocated;
+    const int strideArgsOffset = allocatedArgsOffset + numOutAllocated;
     for (int i : c10::irange(strideArgsFrom_.size())) {
       auto &item = strideArgsFrom_[i];
       callArgs[strideArgsOffset + i] =
@@ -399,8 +792,6 @@ struct PointwiseOperatorCompileResult
 
     int shapeArgsOffset = strideArgsOffset + strideArgsFrom_.size();
     size_t numel = 1;
-    // NOLINTNEXTLINE: C-style arrays
-    int64_t shapes[MAX_DIMS];
     int ndims = shapeFrom_.size();
     for (int i = 0; i < ndims; ++i) {
       shapes[i] = args[shapeFrom_[i].first].size(shapeFrom_[i].second);
@@ -408,76 +799,130 @@ struct PointwiseOperatorCompileResult
       callArgs[shapeArgsOffset + i] = &shapes[i];
     }
 
-    for (int i = 0; i < Counts::numOutAllocated; ++i) {
-      int optionsFrom = allocatedOutputs_[i].first;
-      auto &outputOrder = allocatedOutputs_[i].second;
-      // NOLINTNEXTLINE: C-style arrays
-      int64_t strides[MAX_DIMS];
+    const int scalarArgsOffset = shapeArgsOffset + ndims;
+    for (int i = 0; i < scalars.size; ++i) {
+      callArgs[scalarArgsOffset + i] =
+          // NOLINTNEXTLINE: const_cast
+          const_cast<int64_t *>(&scalars.slots[i]);
+    }
+
+    for (int i = 0; i < numOutAllocated; ++i) {
+      const AllocatedOutput &output = allocatedOutputs_[i];
+      // Reduction outputs have fewer dims than the iteration space.
+      const int outputDims = output.storageOrder.size();
       int64_t nextStride = 1;
-      for (int j : outputOrder) {
+      for (int j : output.storageOrder) {
         strides[j] = nextStride;
         nextStride *= shapes[j];
       }
+      at::TensorOptions options = args[output.optionsFrom].options();
+      if (output.dtype.has_value()) {
+        options = options.dtype(*output.dtype);
+      }
       args[allocatedArgsOffset + i] =
-          at::empty_strided(c10::IntArrayRef(shapes, shapes + ndims),
-                            c10::IntArrayRef(strides, strides + ndims),
-                            args[optionsFrom].options());
+          at::empty_strided(c10::IntArrayRef(shapes, shapes + outputDims),
+                            c10::IntArrayRef(strides, strides + outputDims),
+                            options);
       callArgs[allocatedArgsOffset + i] =
           args[allocatedArgsOffset + i].data_ptr();
     }
 
-    // Release the GIL before calling the kernel, unless the kernel is
-    // tiny.
-    if (numel < 128) {
-      // TODO(jansel): should we also skip releasing the GIL on GPU?
+    // Release the GIL before calling the kernel, unless we aren't holding
+    // it (cache hits from C++ don't take it) or the kernel is expected to
+    // be faster than releasing and reacquiring it.  For GPU kernels, that's
+    // the time to launch them.
+    if (!PyGILState_Check()) {
       cg_->call_with_numel(callArgs, numel);
-    } else {
+    } else if (C10_UNLIKELY(gilStats_.shouldSample())) {
+      gilStats_.sample(numel, [&] { cg_->call_with_numel(callArgs, numel); });
+    } else if (gilStats_.shouldRelease(numel)) {
       py::gil_scoped_release release;
       cg_->call_with_numel(callArgs, numel);
+    } else {
+      cg_->call_with_numel(callArgs, numel);
+    }
+
+    if (C10_UNLIKELY(convertOutputs_)) {
+      // e.g. reductions of half tensors, which accumulate in float
+      for (int i = 0; i < numOutAllocated; ++i) {
+        const auto &resultDtype = allocatedOutputs_[i].resultDtype;
+        if (resultDtype.has_value()) {
+          args[allocatedArgsOffset + i] =
+              args[allocatedArgsOffset + i].to(*resultDtype);
+        }
+      }
     }
 
-    if (backwards_functions_.size() > 0) {
+    if (backward_ != nullptr) {
       std::shared_ptr<CompiledAutoGradNode> node(new CompiledAutoGradNode(),
                                                  torch::autograd::deleteNode);
-      node->setup(backwards_functions_, args, Counts::numIn);
-      for (int i = 0; i < Counts::numOut; ++i) {
-        torch::autograd::create_gradient_edge(args[Counts::numIn + i], node);
+      node->setup(backward_, args, scalars);
+      for (int i = 0; i < numOut; ++i) {
+        torch::autograd::create_gradient_edge(args[numIn + i], node);
       }
     }
   }
 
   /// Check error conditions, e.g. mismatched input sizes.
-  void errorChecks() {
+  void errorChecks(int numIn, int numKeys, int numOutAllocated, int maxDims) {
     TORCH_CHECK(cg_ != nullptr);
-    TORCH_CHECK(shapeFrom_.size() <= MAX_DIMS);
-    TORCH_CHECK(allocatedOutputs_.size() == Counts::numOutAllocated);
-    TORCH_CHECK(backwards_functions_.size() <= Counts::numIn);
+    TORCH_CHECK(shapeFrom_.size() <= maxDims);
+    TORCH_CHECK(allocatedOutputs_.size() == numOutAllocated);
+    if (backward_ != nullptr) {
+      for (int i : backward_->gradInputs) {
+        TORCH_CHECK(i < numIn);
+      }
+      for (int i : backward_->savedInputs) {
+        TORCH_CHECK(i < numIn);
+      }
+    }
     TORCH_CHECK(strideArgsFrom_.size() + shapeFrom_.size() <=
-                Counts::numKeys * MAX_DIMS + MAX_DIMS);
+                numKeys * maxDims + maxDims);
     for (auto &item : shapeFrom_) {
-      TORCH_CHECK(item.first < Counts::numKeys);
-      TORCH_CHECK(item.second < MAX_DIMS);
+      TORCH_CHECK(item.first < numKeys);
+      TORCH_CHECK(item.second < maxDims);
     }
     for (auto &item : strideArgsFrom_) {
-      TORCH_CHECK(item.first < Counts::numKeys);
-      TORCH_CHECK(item.second < MAX_DIMS);
+      TORCH_CHECK(item.first < numKeys);
+      TORCH_CHECK(item.second < maxDims);
     }
     for (auto &item : shapeChecks_) {
-      TORCH_CHECK(std::get<0>(item) < Counts::numKeys);
-      TORCH_CHECK(std::get<1>(item) < MAX_DIMS);
-      TORCH_CHECK(std::get<2>(item) < Counts::numKeys);
-      TORCH_CHECK(std::get<3>(item) < MAX_DIMS);
+      TORCH_CHECK(std::get<0>(item) < numKeys);
+      TORCH_CHECK(std::get<1>(item) < maxDims);
+      TORCH_CHECK(std::get<2>(item) < numKeys);
+      TORCH_CHECK(std::get<3>(item) < maxDims);
     }
     for (auto &item : allocatedOutputs_) {
-      TORCH_CHECK(item.first < Counts::numKeys);
-      TORCH_CHECK(item.second.size() <= MAX_DIMS);
+      TORCH_CHECK(item.optionsFrom < numKeys);
+      TORCH_CHECK(item.storageOrder.size() <= shapeFrom_.size());
+      for (int d : item.storageOrder) {
+        TORCH_CHECK(d < static_cast<int>(item.storageOrder.size()));
+      }
     }
   }
 
 private:
+  /// Output allocated by the kernel.
+  struct AllocatedOutput {
+    /// Argument to take the tensor options of the output from.
+    int optionsFrom;
+
+    /// Dims of the output, innermost first.
+    std::vector<int> storageOrder;
+
+    /// Dtype the kernel writes the output in, if not that of optionsFrom.
+    c10::optional<at::ScalarType> dtype;
+
+    /// Dtype to convert the output to after the kernel, if any.
+    c10::optional<at::ScalarType> resultDtype;
+  };
+
   /// Cached generated code.
   CodeGen *cg_ = nullptr;
 
+  /// Summary of the specialization key, for profiler events.
+  std::string specSummary_;
+
   /// Python handle to generated code object, for refcounting.
   py::object pyCg_;
 
@@ -492,139 +937,627 @@ private:
   std::vector<std::tuple<int, int, int, int>> shapeChecks_;
 
   /// Outputs to allocate.
-  std::vector<std::pair<int, std::vector<int>>> allocatedOutputs_;
+  std::vector<AllocatedOutput> allocatedOutputs_;
+
+  /// Whether any output is converted to a result dtype after the kernel.
+  bool convertOutputs_ = false;
+
+  /// Backward pass, if any input requires grad.
+  std::shared_ptr<const CompiledBackward> backward_;
+
+  /// Python handle to the backward kernel, for refcounting.
+  py::object backwardObject_;
 
-  std::vector<CompileCacheBackwards> backwards_functions_;
-  std::vector<py::object> objects_;
+  /// Number of cache lookups that found this kernel, sharded since calls from
+  /// many threads count it.
+  ShardedCounter hits_;
+
+  /// Time it took to compile this kernel, in seconds.
+  double compileTime_ = 0;
+
+  /// Timings deciding whether calls release the GIL.
+  GilReleaseStats gilStats_;
 };
 
-/// Class template for a kernel cache specialized on the number of
-/// kernel args and max tensor dimensions.
-template <typename Counts, int MAX_DIMS> struct ArgAndDimSpecializedCache {
-  /// Construct a cache that compiles kernels using the supplied compileFn.
-  explicit ArgAndDimSpecializedCache(py::object compileFn)
-      : compileFn_(std::move(compileFn)) {}
+/// Template container for a compiled kernel, specialized on the count
+/// of arguments (from specializing ArgCounts) and the maximum number
+/// of tensor dimensions.
+template <typename Counts, int MAX_DIMS>
+struct PointwiseOperatorCompileResult
+    : public PointwiseOperatorCompileResultImpl {
+  /// Call the cached kernel with the provided args.
+  void call(at::Tensor *args, const ScalarArgs &scalars) {
+    // NOLINTNEXTLINE: C-style arrays
+    void *callArgs[Counts::numBuffers + (Counts::numKeys + 1) * MAX_DIMS +
+                   ScalarArgs::kMax];
+    // NOLINTNEXTLINE: C-style arrays
+    int64_t shapes[MAX_DIMS];
+    // NOLINTNEXTLINE: C-style arrays
+    int64_t strides[MAX_DIMS];
+    launch(args, scalars, Counts::numIn, Counts::numKeys,
+           Counts::numOutAllocated, Counts::numOut, callArgs, shapes, strides);
+  }
 
-  /// Call the cached kernel matching args.
-  void call(at::Tensor *args) {
-    cachedCompile(computeCacheKey(args), args)->call(args);
+  /// Check error conditions, e.g. mismatched input sizes.
+  void errorChecks() {
+    PointwiseOperatorCompileResultImpl::errorChecks(
+        Counts::numIn, Counts::numKeys, Counts::numOutAllocated, MAX_DIMS);
   }
+};
 
-private:
-  /// Array of keys used for specializing kernels in this cache.
-  using SpecializationKeys =
-      std::array<SpecializationKey<MAX_DIMS>, Counts::numKeys>;
+/// Compiled kernel for any number of arguments and dimensions, used above the
+/// limits of the fixed-size caches.
+struct DynamicPointwiseOperatorCompileResult
+    : public PointwiseOperatorCompileResultImpl {
+  DynamicPointwiseOperatorCompileResult(int numIn, int numOutAllocated,
+                                        int numOutGiven, int maxDims)
+      : numIn_(numIn), numOutAllocated_(numOutAllocated),
+        numOutGiven_(numOutGiven), maxDims_(maxDims) {}
 
-  /// Compiled kernel.
-  using CachedResult = PointwiseOperatorCompileResult<Counts, MAX_DIMS>;
+  /// Call the cached kernel with the provided args.
+  void call(at::Tensor *args, const ScalarArgs &scalars) {
+    const int numKeys = numIn_ + numOutGiven_;
+    const int numOut = numOutAllocated_ + numOutGiven_;
+    c10::SmallVector<void *, 64> callArgs(
+        numIn_ + numOut + (numKeys + 1) * maxDims_ + scalars.size);
+    c10::SmallVector<int64_t, 16> shapes(maxDims_);
+    c10::SmallVector<int64_t, 16> strides(maxDims_);
+    launch(args, scalars, numIn_, numKeys, numOutAllocated_, numOut,
+           callArgs.data(), shapes.data(), strides.data());
+  }
 
-  /// Array defining groups of aliased tensors.
-  using AliasGroups = std::array<int8_t, Counts::numKeys>;
+  /// Check error conditions, e.g. mismatched input sizes.
+  void errorChecks() {
+    PointwiseOperatorCompileResultImpl::errorChecks(
+        numIn_, numIn_ + numOutGiven_, numOutAllocated_, maxDims_);
+  }
 
-  /// Cache type mapping specialization keys to compiled kernels.
-  using Cache = std::map<SpecializationKeys, std::unique_ptr<CachedResult>>;
+private:
+  int numIn_;
+  int numOutAllocated_;
+  int numOutGiven_;
+  int maxDims_;
+};
 
-  /// Compile a kernel for the given specializations.
-  std::unique_ptr<CachedResult> compile(const SpecializationKeys &key,
-                                        at::Tensor *args) {
-    // Handle a cache miss by creating a new specialized implementation.
-    checkDispatchKeys(key);
-    auto cr = std::make_unique<CachedResult>();
-    std::vector<py::object> spec;
-    spec.reserve(Counts::numKeys);
-    for (int i = 0; i < Counts::numKeys; i++) {
-      spec.emplace_back(key[i].toPython(args[i], i >= Counts::numIn));
-    }
-    compileFn_(spec, PoinwiseOperatorCompileResultProxy(cr.get()));
-    cr->errorChecks();
-    return cr;
+/// Compile a kernel into result with compileFn(spec, result), recording the
+/// time it took.
+static void compileKernel(const py::object &compileFn, const py::list &spec,
+                          PointwiseOperatorCompileResultImpl *result) {
+  auto start = std::chrono::steady_clock::now();
+  compileFn(spec, PoinwiseOperatorCompileResultProxy(result));
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  result->setCompileTime(elapsed.count());
+}
+
+/// Copy of a python dict with field name set to value.
+static py::dict withField(const py::dict &dict, const char *name,
+                          py::object value) {
+  auto copy = py::reinterpret_steal<py::dict>(PyDict_Copy(dict.ptr()));
+  if (!copy) {
+    throw py::error_already_set();
   }
+  copy[name] = std::move(value);
+  return copy;
+}
 
-  /// Retrieve a kernel from cache or compile if not found.
-  CachedResult *cachedCompile(const SpecializationKeys &key, at::Tensor *args) {
-    auto item = cache_.find(key); // protected by GIL
-    if (C10_LIKELY(item != cache_.end())) {
-      return item->second.get();
-    } else { // cache miss
-      auto iter = cache_.emplace(key, compile(key, args)).first;
-      return iter->second.get();
-    }
+/// Record of a cached kernel, for PointwiseOperatorCompileCache::
+/// cachedKernels: route, which locates the cache holding the kernel, with the
+/// serialized key, the key as passed to the compile function, and the stats
+/// of the kernel, including the timings deciding whether it releases the GIL.
+static py::dict kernelRecord(const py::dict &route, py::bytes key,
+                             py::list spec,
+                             const PointwiseOperatorCompileResultImpl &result) {
+  py::dict record = withField(route, "key", std::move(key));
+  record["spec"] = std::move(spec);
+  record["hits"] = result.hits();
+  record["compile_time"] = result.compileTime();
+  const GilReleaseStats &gilStats = result.gilStats();
+  record["timed_calls"] = gilStats.samples();
+  record["ns_per_element"] = gilStats.nsPerElement();
+  record["gil_release_ns"] = gilStats.gilReleaseNs();
+  return record;
+}
+
+/// Verify that the current set of dispatch keys is supported by
+/// the kernels, or throw an error.
+static void checkDispatchKeys(at::DispatchKeySet ks) {
+  constexpr at::DispatchKeySet supported = at::DispatchKeySet({
+      at::DispatchKey::CPU,
+      at::DispatchKey::CUDA,
+      at::DispatchKey::AutogradCPU,
+      at::DispatchKey::AutogradCUDA,
+      at::DispatchKey::BackendSelect,
+      at::DispatchKey::ADInplaceOrView,
+  });
+  ks = ks - supported;
+  if (C10_LIKELY(ks.empty())) {
+    return;
   }
+  std::stringstream ss;
+  ss << "DispatchKeys not yet supported:";
+  for (at::DispatchKey k : ks) {
+    ss << " " << k;
+  }
+  throw std::runtime_error(ss.str());
+}
 
-  /// Verify that the current set of dispatch keys is supported by
-  /// this kernel, or throw an error.
-  void checkDispatchKeys(const SpecializationKeys &key) {
-    at::DispatchKeySet ks;
-    for (auto &item : key) {
-      ks = ks | item.dispatchKey();
-    }
-    constexpr at::DispatchKeySet supported = at::DispatchKeySet({
-        at::DispatchKey::CPU,
-        at::DispatchKey::CUDA,
-        at::DispatchKey::AutogradCPU,
-        at::DispatchKey::AutogradCUDA,
-        at::DispatchKey::BackendSelect,
-        at::DispatchKey::ADInplaceOrView,
-    });
-    ks = ks - supported;
-    if (C10_LIKELY(ks.empty())) {
-      return;
-    }
-    std::stringstream ss;
-    ss << "DispatchKeys not yet supported:";
-    for (at::DispatchKey k : ks) {
-      ss << " " << k;
-    }
-    throw std::runtime_error(ss.str());
+/// Greatest common divisor of a and b, with gcd(0, b) = b.
+static int64_t greatestCommonDivisor(int64_t a, int64_t b) {
+  while (b != 0) {
+    int64_t t = a % b;
+    a = b;
+    b = t;
   }
+  return a;
+}
 
-  /// Compute aliasing relationships between tensors a and b.
-  /// 0 means a/b don't alias.
-  /// 1 means a/b alias and are the same.
-  /// -1 means a/b have crazy aliasing overlaps.
-  int8_t computeAliasing(const at::Tensor &a, const at::Tensor &b) {
-    if (a.is_alias_of(b)) {
-      if (a.is_set_to(b)) {
-        return 1;
+/// Memory a tensor may access, in bytes relative to the start of its storage.
+struct MemoryExtent {
+  /// Address of the first element.
+  int64_t base;
+
+  /// Range [begin, end) spanned by all elements.
+  int64_t begin;
+  int64_t end;
+
+  /// Size of each element.
+  int64_t itemsize;
+
+  /// GCD of the strides of all non-broadcast dims; every element lies at
+  /// base + k * strideGcd for some integer k.  Zero for a single element.
+  int64_t strideGcd;
+
+  explicit MemoryExtent(const at::Tensor &t)
+      : itemsize(static_cast<int64_t>(t.dtype().itemsize())), strideGcd(0) {
+    base = t.storage_offset() * itemsize;
+    begin = base;
+    end = base + itemsize;
+    for (int64_t dim = 0; dim < t.dim(); ++dim) {
+      if (t.size(dim) == 1) {
+        continue;
+      }
+      int64_t stride = t.stride(dim) * itemsize;
+      int64_t extent = (t.size(dim) - 1) * stride;
+      if (extent < 0) {
+        begin += extent;
       } else {
-        // TODO(jansel): check for non-overlapping and return 0 in cases where
-        // we can prove no aliasing. Possibly could take some logic from
-        // tensoriterator.
-        return -1;
+        end += extent;
       }
-    } else {
-      return 0;
+      strideGcd = greatestCommonDivisor(strideGcd, std::abs(stride));
     }
   }
+};
 
-  /// Compute aliasing groups: group of tensors that alias each other.
-  AliasGroups computeAliasGroups(at::Tensor *args) {
-    AliasGroups aliasGroups;
-    int8_t currentId = 0;
-    for (int i = 0; i < Counts::numKeys; ++i) {
-      aliasGroups[i] = 0;
+/// Return true if tensors a and b, which share storage, provably never
+/// access the same bytes.
+static bool provablyDisjoint(const at::Tensor &a, const at::Tensor &b) {
+  if (a.numel() == 0 || b.numel() == 0) {
+    return true;
+  }
+  MemoryExtent ea(a);
+  MemoryExtent eb(b);
+  // Disjoint ranges, e.g. the two halves of a buffer.
+  if (ea.end <= eb.begin || eb.end <= ea.begin) {
+    return true;
+  }
+  // Interleaved elements, e.g. buf[0::2] and buf[1::2]: every address
+  // difference between elements of a and b is base difference plus a
+  // multiple of g, so they overlap only if one of those lands within an
+  // element, i.e. in (-eb.itemsize, ea.itemsize).
+  int64_t g = greatestCommonDivisor(ea.strideGcd, eb.strideGcd);
+  if (g == 0) {
+    return false;
+  }
+  int64_t offset = ((ea.base - eb.base) % g + g) % g;
+  return offset >= ea.itemsize && g - offset >= eb.itemsize;
+}
+
+/// Compute aliasing relationships between tensors a and b.
+/// 0 means a/b don't alias, or provably access disjoint memory.
+/// 1 means a/b alias and are the same.
+/// -1 means a/b have crazy aliasing overlaps.
+static int8_t computeAliasing(const at::Tensor &a, const at::Tensor &b) {
+  if (!a.is_alias_of(b)) {
+    return 0;
+  }
+  if (a.is_set_to(b)) {
+    return 1;
+  }
+  return provablyDisjoint(a, b) ? 0 : -1;
+}
+
+/// Compute aliasing groups: group of tensors that alias each other.
+static void computeAliasGroups(const at::Tensor *args, int numKeys,
+                               int8_t *aliasGroups) {
+  int8_t currentId = 0;
+  for (int i = 0; i < numKeys; ++i) {
+    aliasGroups[i] = 0;
+  }
+  for (int i = 0; i < numKeys; ++i) {
+    if (aliasGroups[i] == 0) {
+      for (int j = i + 1; j < numKeys; ++j) {
+        int8_t alias_type = computeAliasing(args[i], args[j]);
+        if (alias_type != 0) {
+          if (aliasGroups[i] == 0)
+            ++currentId;
+          aliasGroups[i] = currentId;
+          aliasGroups[j] = currentId * alias_type;
+        }
+      }
     }
-    for (int i = 0; i < Counts::numKeys; ++i) {
-      if (aliasGroups[i] == 0) {
-        for (int j = i + 1; j < Counts::numKeys; ++j) {
-          int8_t alias_type = computeAliasing(args[i], args[j]);
-          if (alias_type != 0) {
-            if (aliasGroups[i] == 0)
-              ++currentId;
-            aliasGroups[i] = currentId;
-            aliasGroups[j] = currentId * alias_type;
-          }
+  }
+}
+
+/// Collapse adjacent dims of the tensors args[0, numKeys) that can be
+/// iterated over as one, like TensorIterator's coalescing, so that e.g.
+/// contiguous [a, b, c, d] and [a * b, c * d] tensors share a kernel with a
+/// flatter loop.  Dims are collapsed jointly across all args: a pair of dims
+/// is merged if it is contiguous in every tensor, or broadcast (size one in
+/// both dims) in the tensors where it isn't.  On success, writes views of
+/// the args with collapsed dims to collapsed and the broadcast shape of the
+/// original args to shape.  The last numReducedDims dims, which a reduction
+/// kernel reduces over, are kept as they are.
+///
+/// Returns false if no dims can be collapsed, or if collapsing isn't safe:
+/// non-strided tensors, tensors requiring grad (the backward kernels expect
+/// the original shapes) and shapes that don't broadcast (the kernel reports
+/// the error).
+static bool collapseDims(const at::Tensor *args, int numKeys,
+                         int numReducedDims, at::Tensor *collapsed,
+                         c10::SmallVector<int64_t, 8> &shape) {
+  const bool gradModeEnabled = at::GradMode::is_enabled();
+  int64_t ndims = 0;
+  for (int i = 0; i < numKeys; ++i) {
+    if (args[i].layout() != at::kStrided ||
+        (gradModeEnabled && args[i].requires_grad())) {
+      return false;
+    }
+    ndims = std::max(args[i].dim(), ndims);
+  }
+  if (ndims < 2) {
+    return false;
+  }
+
+  // Sizes and strides of each tensor, aligned to the broadcast shape.  Dims
+  // missing from a tensor have size one and stride zero.
+  shape.assign(ndims, 1);
+  c10::SmallVector<int64_t, 64> sizes(numKeys * ndims, 1);
+  c10::SmallVector<int64_t, 64> strides(numKeys * ndims, 0);
+  c10::SmallVector<int64_t, 8> firstDim(numKeys);
+  for (int i = 0; i < numKeys; ++i) {
+    c10::IntArrayRef argSizes = args[i].sizes();
+    c10::IntArrayRef argStrides = args[i].strides();
+    firstDim[i] = ndims - static_cast<int64_t>(argSizes.size());
+    for (int64_t d = firstDim[i]; d < ndims; ++d) {
+      int64_t size = argSizes[d - firstDim[i]];
+      if (shape[d] == 1) {
+        shape[d] = size;
+      } else if (size != 1 && size != shape[d]) {
+        return false;
+      }
+      sizes[i * ndims + d] = size;
+      strides[i * ndims + d] = argStrides[d - firstDim[i]];
+    }
+  }
+
+  // Collapse from the innermost dim outwards.  Collapsed dims are stored in
+  // [prev, ndims); inner[p] is the innermost original dim of collapsed dim p.
+  c10::SmallVector<int64_t, 8> collapsedShape(shape.begin(), shape.end());
+  c10::SmallVector<int64_t, 8> inner(ndims);
+  inner[ndims - 1] = ndims - 1;
+  auto canCollapse = [&](int64_t outer, int64_t dim) {
+    if (collapsedShape[outer] == 1 || collapsedShape[dim] == 1) {
+      return true;
+    }
+    for (int i = 0; i < numKeys; ++i) {
+      const int64_t *sz = &sizes[i * ndims];
+      const int64_t *st = &strides[i * ndims];
+      bool broadcast = sz[outer] == 1 && sz[dim] == 1;
+      bool contiguous = sz[outer] != 1 && sz[dim] != 1 &&
+                        st[outer] == st[dim] * sz[dim];
+      if (!broadcast && !contiguous) {
+        return false;
+      }
+    }
+    return true;
+  };
+  int64_t prev = ndims - 1;
+  for (int64_t d = ndims - 2; d >= 0; --d) {
+    if (prev < ndims - numReducedDims && canCollapse(d, prev)) {
+      for (int i = 0; i < numKeys; ++i) {
+        int64_t *sz = &sizes[i * ndims];
+        int64_t *st = &strides[i * ndims];
+        if (collapsedShape[prev] == 1) {
+          sz[prev] = sz[d];
+          st[prev] = st[d];
+        } else {
+          sz[prev] *= sz[d];
+        }
+      }
+      collapsedShape[prev] *= collapsedShape[d];
+    } else {
+      --prev;
+      for (int i = 0; i < numKeys; ++i) {
+        sizes[i * ndims + prev] = sizes[i * ndims + d];
+        strides[i * ndims + prev] = strides[i * ndims + d];
+      }
+      collapsedShape[prev] = collapsedShape[d];
+      inner[prev] = d;
+    }
+  }
+  if (prev == 0) {
+    return false;
+  }
+
+  for (int i = 0; i < numKeys; ++i) {
+    // Leading dims made up only of dims missing from this tensor stay
+    // missing, so keys don't change from SIZE_MISSING to SIZE_ONE.
+    int64_t begin = prev;
+    while (begin < ndims && inner[begin] < firstDim[i]) {
+      ++begin;
+    }
+    collapsed[i] = args[i].as_strided(
+        c10::IntArrayRef(&sizes[i * ndims + begin], ndims - begin),
+        c10::IntArrayRef(&strides[i * ndims + begin], ndims - begin));
+  }
+  return true;
+}
+
+/// Run callFn(at::Tensor *args) on args with collapsed dims (see
+/// collapseDims), or on args themselves if no dims can be collapsed.
+/// Allocated outputs, args[numKeys, numBuffers), are viewed back to the
+/// original shape, without the last numReducedDims dims, if callFn set them;
+/// given outputs are written through the collapsed views.  collapsed must
+/// have room for numBuffers tensors.
+template <typename CallFn>
+static void callWithCollapsedDims(at::Tensor *args, int numKeys,
+                                  int numBuffers, int numReducedDims,
+                                  at::Tensor *collapsed, const CallFn &callFn) {
+  c10::SmallVector<int64_t, 8> shape;
+  if (!collapseDims(args, numKeys, numReducedDims, collapsed, shape)) {
+    callFn(args);
+    return;
+  }
+  callFn(collapsed);
+  c10::IntArrayRef outputShape(shape.data(), shape.size() - numReducedDims);
+  for (int i = numKeys; i < numBuffers; ++i) {
+    if (collapsed[i].defined()) {
+      args[i] = collapsed[i].view(outputShape);
+    }
+  }
+}
+
+/// Class template for a kernel cache specialized on the number of
+/// kernel args and max tensor dimensions.
+///
+/// Lookups don't need the GIL or any lock: entries are only ever added to the
+/// hash table, each one published by an atomic store of its result once its
+/// key is written, so readers see either a complete entry or an empty slot.
+/// A miss takes the GIL to compile, and writers only run while holding the
+/// GIL, which serializes them. When the table gets too full, writers publish
+/// a copy twice its size. Readers may still be probing the replaced table, so
+/// it is retired rather than freed; since tables double, the retired ones take
+/// less memory than the current one.
+template <typename Counts, int MAX_DIMS> struct ArgAndDimSpecializedCache {
+  /// Construct a cache that compiles kernels using the supplied compileFn.
+  explicit ArgAndDimSpecializedCache(py::object compileFn)
+      : compileFn_(std::move(compileFn)) {
+    tables_.emplace_back(std::make_unique<Table>(8));
+    table_.store(tables_.back().get(), std::memory_order_release);
+  }
+
+  /// Call the cached kernel matching args.
+  void call(at::Tensor *args, const ScalarArgs &scalars) {
+    cachedCompile(computeCacheKey(args))->call(args, scalars);
+  }
+
+  /// Compile the kernel matching args, unless cached, without calling it.
+  void precompile(at::Tensor *args) { cachedCompile(computeCacheKey(args)); }
+
+  /// Compile the kernel for record["key"], a key listed by cachedKernels,
+  /// unless cached.
+  void precompileRecord(const py::dict &record) {
+    std::string bytes = record["key"].cast<std::string>();
+    TORCH_CHECK(bytes.size() == sizeof(SpecializationKeys),
+                "malformed specialization key");
+    SpecializationKeys key;
+    memcpy(&key, bytes.data(), sizeof(SpecializationKeys));
+    cachedCompile(key);
+  }
+
+  /// Append a record of every cached kernel to records (see kernelRecord).
+  void cachedKernels(py::list &records, const py::dict &route) const {
+    py::dict dimsRoute = withField(route, "max_dims", py::int_(MAX_DIMS));
+    const Table *table = table_.load(std::memory_order_acquire);
+    for (size_t idx = 0; idx < table->capacity; ++idx) {
+      const Entry &entry = table->entries[idx];
+      const CachedResult *result =
+          entry.result.load(std::memory_order_acquire);
+      if (result != nullptr) {
+        py::bytes key(reinterpret_cast<const char *>(&entry.key),
+                      sizeof(SpecializationKeys));
+        records.append(kernelRecord(dimsRoute, std::move(key),
+                                    toPython(entry.key), *result));
+      }
+    }
+  }
+
+private:
+  /// Array of keys used for specializing kernels in this cache.
+  using SpecializationKeys =
+      std::array<SpecializationKey<MAX_DIMS>, Counts::numKeys>;
+
+  /// Compiled kernel.
+  using CachedResult = PointwiseOperatorCompileResult<Counts, MAX_DIMS>;
+
+  /// Array defining groups of aliased tensors.
+  using AliasGroups = std::array<int8_t, Counts::numKeys>;
+
+  static_assert(sizeof(SpecializationKeys) ==
+                    Counts::numKeys * (10 + MAX_DIMS),
+                "keys are not packed, memcmp requires no padding");
+
+  /// Entry of the cache. A null result marks an empty slot. The hash and key
+  /// are written before the result is stored, and never change afterwards.
+  struct Entry {
+    uint64_t hash = 0;
+    SpecializationKeys key;
+    std::atomic<CachedResult *> result{nullptr};
+
+    bool matches(const SpecializationKeys &other, uint64_t otherHash) const {
+      return hash == otherHash &&
+             memcmp(&key, &other, sizeof(SpecializationKeys)) == 0;
+    }
+  };
+
+  /// Cache type mapping specialization keys to compiled kernels: an
+  /// open-addressing (linear probing) hash table of the packed key bytes,
+  /// at most half full. Entries are never removed, so probe sequences seen
+  /// by readers stay valid while writers add entries.
+  struct Table {
+    explicit Table(size_t capacity)
+        : entries(new Entry[capacity]), capacity(capacity) {}
+
+    std::unique_ptr<Entry[]> entries;
+    size_t capacity;
+    /// Number of entries. Only used by writers.
+    size_t size = 0;
+
+    const Entry *find(const SpecializationKeys &key, uint64_t hash) const {
+      size_t mask = capacity - 1;
+      for (size_t idx = hash & mask;; idx = (idx + 1) & mask) {
+        const Entry &entry = entries[idx];
+        if (entry.result.load(std::memory_order_acquire) == nullptr) {
+          return nullptr;
+        }
+        if (entry.matches(key, hash)) {
+          return &entry;
         }
       }
     }
-    return aliasGroups;
+
+    /// Whether adding an entry would make the table more than half full.
+    bool full() const { return (size + 1) * 2 > capacity; }
+
+    /// Add an entry for key, publishing it to readers. Needs the GIL.
+    void insert(const SpecializationKeys &key, uint64_t hash,
+                CachedResult *result) {
+      TORCH_INTERNAL_ASSERT(!full());
+      size_t mask = capacity - 1;
+      size_t idx = hash & mask;
+      while (entries[idx].result.load(std::memory_order_relaxed) != nullptr) {
+        idx = (idx + 1) & mask;
+      }
+      Entry &entry = entries[idx];
+      entry.hash = hash;
+      entry.key = key;
+      entry.result.store(result, std::memory_order_release);
+      size++;
+    }
+
+    /// Return a copy of this table with twice the capacity. Needs the GIL.
+    std::unique_ptr<Table> grown() const {
+      auto next = std::make_unique<Table>(capacity * 2);
+      for (size_t idx = 0; idx < capacity; ++idx) {
+        const Entry &entry = entries[idx];
+        CachedResult *result = entry.result.load(std::memory_order_relaxed);
+        if (result != nullptr) {
+          next->insert(entry.key, entry.hash, result);
+        }
+      }
+      return next;
+    }
+  };
+
+  /// Convert key to the spec passed to the compile function.
+  static py::list toPython(const SpecializationKeys &key) {
+    py::list spec;
+    for (int i = 0; i < Counts::numKeys; i++) {
+      spec.append(key[i].toPython(i >= Counts::numIn));
+    }
+    return spec;
+  }
+
+  /// Compile a kernel for the given specializations.
+  std::unique_ptr<CachedResult> compile(const SpecializationKeys &key) {
+    // Handle a cache miss by creating a new specialized implementation.
+    at::DispatchKeySet ks;
+    for (auto &item : key) {
+      ks = ks | item.dispatchKey();
+    }
+    checkDispatchKeys(ks);
+    auto cr = std::make_unique<CachedResult>();
+    compileKernel(compileFn_, toPython(key), cr.get());
+    cr->errorChecks();
+    return cr;
+  }
+
+  /// Retrieve a kernel from cache or compile if not found.
+  CachedResult *cachedCompile(const SpecializationKeys &key) {
+    uint64_t hash = hashBytes(&key, sizeof(SpecializationKeys));
+    // Most call sites always pass tensors with the same properties, so check
+    // the last hit before probing the table.
+    const Entry *last = lastHit_.load(std::memory_order_acquire);
+    if (C10_LIKELY(last != nullptr && last->matches(key, hash))) {
+      CachedResult *result = last->result.load(std::memory_order_relaxed);
+      result->recordHit();
+      return result;
+    }
+    const Table *table = table_.load(std::memory_order_acquire);
+    const Entry *entry = table->find(key, hash);
+    if (C10_LIKELY(entry != nullptr)) {
+      lastHit_.store(entry, std::memory_order_release);
+      CachedResult *result = entry->result.load(std::memory_order_relaxed);
+      result->recordHit();
+      return result;
+    }
+    return compileAndPublish(key, hash);
+  }
+
+  /// Handle a cache miss: compile a kernel for key and add it to the table.
+  C10_NOINLINE CachedResult *compileAndPublish(const SpecializationKeys &key,
+                                               uint64_t hash) {
+    py::gil_scoped_acquire guard;
+
+    // Another thread may have compiled the kernel while we waited for the
+    // GIL.
+    const Entry *entry =
+        table_.load(std::memory_order_relaxed)->find(key, hash);
+    if (entry != nullptr) {
+      CachedResult *result = entry->result.load(std::memory_order_relaxed);
+      result->recordHit();
+      return result;
+    }
+
+    std::unique_ptr<CachedResult> cr = compile(key);
+
+    // compileFn_ may have released the GIL, letting another thread publish
+    // a kernel for the same key in the meantime.
+    Table *table = table_.load(std::memory_order_relaxed);
+    entry = table->find(key, hash);
+    if (entry != nullptr) {
+      return entry->result.load(std::memory_order_relaxed);
+    }
+    CachedResult *result = cr.get();
+    results_.emplace_back(std::move(cr));
+    if (!table->full()) {
+      table->insert(key, hash, result);
+      return result;
+    }
+    tables_.emplace_back(table->grown());
+    table = tables_.back().get();
+    table->insert(key, hash, result);
+    table_.store(table, std::memory_order_release);
+    return result;
   }
 
   /// Compute the set of specialization keys based on the inputs to
   /// the kernel.
   SpecializationKeys computeCacheKey(at::Tensor *args) {
     LocalState state;
-    AliasGroups aliasGroups = computeAliasGroups(args);
+    AliasGroups aliasGroups;
+    computeAliasGroups(args, Counts::numKeys, aliasGroups.data());
     SpecializationKeys key;
     for (int i = 0; i < Counts::numKeys; ++i) {
       key[i] = SpecializationKey<MAX_DIMS>(state, args[i], aliasGroups[i]);
@@ -633,39 +1566,195 @@ private:
   }
 
 private:
+  /// Current table of the cache.
+  std::atomic<Table *> table_;
+
+  /// Entry of the last successful lookup, in any published table.
+  std::atomic<const Entry *> lastHit_{nullptr};
+
+  /// Every table published so far, including the current one. Only
+  /// modified while holding the GIL.
+  std::vector<std::unique_ptr<Table>> tables_;
+
+  /// Storage for the compiled kernels. Only modified while holding the GIL.
+  std::vector<std::unique_ptr<CachedResult>> results_;
+
+  /// The compilation function to apply when filling the cache.
+  py::object compileFn_;
+};
+
+/// Kernel cache for any number of args and tensor dimensions, used above the
+/// limits of the fixed-size caches. Slower than those: its keys are heap
+/// allocated and lookups take the GIL.
+struct DynamicArgCache {
+  /// Construct a cache that compiles kernels using the supplied compileFn.
+  DynamicArgCache(py::object compileFn, int numIn, int numOutAllocated,
+                  int numOutGiven)
+      : compileFn_(std::move(compileFn)), numIn_(numIn),
+        numOutAllocated_(numOutAllocated), numOutGiven_(numOutGiven) {}
+
+  /// Call the cached kernel matching args.
+  void call(at::Tensor *args, const ScalarArgs &scalars) {
+    cachedCompile(args)->call(args, scalars);
+  }
+
+  /// Compile the kernel matching args, unless cached, without calling it.
+  void precompile(at::Tensor *args) { cachedCompile(args); }
+
+  /// Compile the kernel for record["key"], a key listed by cachedKernels,
+  /// unless cached.
+  void precompileRecord(const py::dict &record) {
+    cachedCompile(DynamicSpecializationKey(record["key"].cast<std::string>(),
+                                           numIn_ + numOutGiven_));
+  }
+
+  /// Append a record of every cached kernel to records (see kernelRecord).
+  void cachedKernels(py::list &records, const py::dict &route) const {
+    py::dict dimsRoute = withField(route, "max_dims", py::none());
+    for (const auto &item : cache_) {
+      records.append(kernelRecord(dimsRoute, py::bytes(item.first.bytes()),
+                                  toPython(item.first), *item.second));
+    }
+  }
+
+private:
+  using CachedResult = DynamicPointwiseOperatorCompileResult;
+
+  /// Retrieve a kernel from cache or compile if not found.
+  CachedResult *cachedCompile(at::Tensor *args) {
+    const int numKeys = numIn_ + numOutGiven_;
+    c10::SmallVector<int8_t, 16> aliasGroups(numKeys);
+    computeAliasGroups(args, numKeys, aliasGroups.data());
+    return cachedCompile(DynamicSpecializationKey(
+        LocalState(), args, aliasGroups.data(), numKeys));
+  }
+
+  /// Retrieve the kernel for key from cache or compile if not found.
+  CachedResult *cachedCompile(const DynamicSpecializationKey &key) {
+    py::gil_scoped_acquire guard; // we protect this cache w/ GIL
+    auto item = cache_.find(key);
+    if (item == cache_.end()) {
+      item = cache_.emplace(key, compile(key)).first;
+    } else {
+      item->second->recordHit();
+    }
+    return item->second.get();
+  }
+
+  /// Convert key to the spec passed to the compile function.
+  py::list toPython(const DynamicSpecializationKey &key) const {
+    py::list spec;
+    for (int i = 0; i < numIn_ + numOutGiven_; i++) {
+      spec.append(key.toPython(i, i >= numIn_));
+    }
+    return spec;
+  }
+
+  /// Compile a kernel for the given specializations.
+  std::unique_ptr<CachedResult> compile(const DynamicSpecializationKey &key) {
+    checkDispatchKeys(key.dispatchKeys());
+    auto cr = std::make_unique<CachedResult>(numIn_, numOutAllocated_,
+                                             numOutGiven_, key.maxDims());
+    compileKernel(compileFn_, toPython(key), cr.get());
+    cr->errorChecks();
+    return cr;
+  }
+
   /// Storage for the cache.
-  Cache cache_;
+  std::unordered_map<DynamicSpecializationKey, std::unique_ptr<CachedResult>,
+                     DynamicSpecializationKey::Hash>
+      cache_;
 
   /// The compilation function to apply when filling the cache.
   py::object compileFn_;
+
+  int numIn_;
+  int numOutAllocated_;
+  int numOutGiven_;
 };
 
 /// Class template for kernel cache specialized on the number of args
 /// to the kernel, as given by a template parameter of type ArgCounts.
 template <typename Counts> struct ArgSpecializedCache {
-  /// Construct the cache with compilation function compileFn.
-  ArgSpecializedCache(const py::object &compileFn)
-      : cache2(compileFn), cache4(compileFn), cache8(compileFn) {}
+  /// Construct the cache with compilation function compileFn, for kernels
+  /// reducing over the last numReducedDims dims.
+  ArgSpecializedCache(const py::object &compileFn, int numReducedDims)
+      : cache2(compileFn), cache4(compileFn), cache8(compileFn),
+        cacheDynamic(compileFn, Counts::numIn, Counts::numOutAllocated,
+                     Counts::numOutGiven),
+        numReducedDims_(numReducedDims) {}
 
   /// Call the cached kernel with args.
-  void call(at::Tensor *args) {
+  void call(at::Tensor *args, const ScalarArgs &scalars) {
+    // NOLINTNEXTLINE: C-style arrays
+    at::Tensor collapsed[Counts::numBuffers];
+    callWithCollapsedDims(
+        args, Counts::numKeys, Counts::numBuffers, numReducedDims_, collapsed,
+        [this, &scalars](at::Tensor *a) {
+          withBucket(a, [a, &scalars](auto &cache) { cache.call(a, scalars); });
+        });
+  }
+
+  /// Compile the kernel for args, unless cached, without calling it.
+  void precompile(at::Tensor *args) {
+    // NOLINTNEXTLINE: C-style arrays
+    at::Tensor collapsed[Counts::numBuffers];
+    callWithCollapsedDims(
+        args, Counts::numKeys, Counts::numBuffers, numReducedDims_, collapsed,
+        [this](at::Tensor *a) {
+          withBucket(a, [a](auto &cache) { cache.precompile(a); });
+        });
+  }
+
+  /// Compile the kernel for a record listed by cachedKernels, unless cached.
+  void precompileRecord(const py::dict &record) {
+    py::object maxDims = record["max_dims"];
+    if (maxDims.is_none()) {
+      cacheDynamic.precompileRecord(record);
+      return;
+    }
+    switch (maxDims.cast<int>()) {
+    case 2:
+      cache2.precompileRecord(record);
+      break;
+    case 4:
+      cache4.precompileRecord(record);
+      break;
+    case 8:
+      cache8.precompileRecord(record);
+      break;
+    default:
+      TORCH_CHECK(false, "malformed kernel record: max_dims=", maxDims);
+    }
+  }
+
+  /// Append a record of every cached kernel to records.
+  void cachedKernels(py::list &records, const py::dict &route) const {
+    cache2.cachedKernels(records, route);
+    cache4.cachedKernels(records, route);
+    cache8.cachedKernels(records, route);
+    cacheDynamic.cachedKernels(records, route);
+  }
+
+private:
+  /// Run fn(cache) on the cache for args, after collapsing dims.
+  template <typename Fn> void withBucket(at::Tensor *args, const Fn &fn) {
     // Fan out and and specialize on number of dimension buckets.
     int64_t ndims = 0;
     for (int i : c10::irange(Counts::numIn + Counts::numOutGiven)) {
       ndims = std::max(args[i].dim(), ndims);
     }
     if (ndims <= 2) {
-      cache2.call(args);
+      fn(cache2);
     } else if (ndims <= 4) {
-      cache4.call(args);
+      fn(cache4);
     } else if (ndims <= 8) {
-      cache8.call(args);
+      fn(cache8);
     } else {
-      throw std::runtime_error("TODO: handle more dims");
+      fn(cacheDynamic);
     }
   }
 
-private:
   /// Cache kernels with tensors having a max of 2 dims.
   ArgAndDimSpecializedCache<Counts, 2> cache2;
 
@@ -674,6 +1763,12 @@ private:
 
   /// Cache kernels with tensors having a max of 8 dims.
   ArgAndDimSpecializedCache<Counts, 8> cache8;
+
+  /// Cache kernels with tensors having more than 8 dims.
+  DynamicArgCache cacheDynamic;
+
+  /// Number of trailing dims the kernels reduce over.
+  int numReducedDims_;
 };
 
 /// Kernel cache interface.
@@ -684,54 +1779,205 @@ struct PointwiseOperatorCompileCache {
   /// Call kernel using python objects.
   virtual PyObject *pyCall(PyObject *args, PyObject *kwargs) = 0;
 
-  /// Call kernel using vector of tensors.
-  virtual at::Tensor call(const std::vector<at::Tensor> &args) = 0;
+  /// Call kernel using vector of tensors, returning its outputs.
+  virtual std::vector<at::Tensor> call(const std::vector<at::Tensor> &args) = 0;
+
+  /// Call kernel with unpacked args: the tensor inputs followed by the
+  /// outputs, where a single output may be given (the out variant), and the
+  /// scalar args passed to the kernel as parameters.
+  virtual void callUnpacked(at::Tensor *tensorArgs,
+                            const ScalarArgs &scalars) = 0;
+
+  /// Compile the kernel for a call using python objects, unless cached,
+  /// without calling it.
+  virtual void pyPrecompile(PyObject *args, PyObject *kwargs) = 0;
+
+  /// Compile the kernel for a call with unpacked tensor args (see
+  /// callUnpacked), unless cached, without calling it.
+  virtual void precompileUnpacked(at::Tensor *tensorArgs) = 0;
+
+  /// Compile the kernel for a record listed by cachedKernels, unless cached.
+  virtual void precompileRecord(const py::dict &record) = 0;
+
+  /// Append a record of every cached kernel to records: a dict with the
+  /// serialized specialization key, fields locating the cache it is in, the
+  /// key as passed to the compile function ("spec"), the number of cache
+  /// lookups that found it ("hits"), the time it took to compile, in
+  /// seconds ("compile_time"), and the timings deciding whether calls release
+  /// the GIL (see GilReleaseStats): "timed_calls", "ns_per_element" and
+  /// "gil_release_ns".  Needs the GIL.
+  virtual void cachedKernels(py::list &records,
+                             const py::dict &route) const = 0;
 
   /// Get name of kernel.
   virtual const std::string &getName() const = 0;
+
+  /// The kernel cache that callUnpacked forwards calls with numScalars
+  /// scalar args to, to call it directly: this cache, unless overloaded.
+  virtual PointwiseOperatorCompileCache *unpackedCache(int /*numScalars*/) {
+    return this;
+  }
 };
 
+/// Run callFn(), recording it in the profiler if callbacks are active, with
+/// the tensor args as inputs.
+template <typename CallFn>
+static void recordCall(const std::string &name, const at::Tensor *tensorArgs,
+                       int numArgs, const CallFn &callFn) {
+  bool presampled = false;
+  if (C10_UNLIKELY(at::hasCallbacks() &&
+                   at::shouldRunRecordFunction(&presampled))) {
+    // One event for the cache lookup and kernel launch.  Compiles on a
+    // cache miss are recorded as "<name>::compile" events by the python
+    // compile function.  When recording inputs, the kernel launch begins the
+    // event, to add the specialization key summary, so compiles come before
+    // it rather than nested in it.
+    at::RecordFunction guard(at::RecordScope::FUNCTION, presampled);
+    if (guard.isActive() && guard.needsInputs()) {
+      PendingCallEvent event{&guard, &name, tensorArgs, numArgs};
+      PendingCallEvent *outer = pendingCallEvent;
+      pendingCallEvent = &event;
+      try {
+        callFn();
+      } catch (...) {
+        if (pendingCallEvent == &event) {
+          beginPendingCallEvent(nullptr);
+        }
+        pendingCallEvent = outer;
+        throw;
+      }
+      // In case no kernel was launched
+      if (pendingCallEvent == &event) {
+        beginPendingCallEvent(nullptr);
+      }
+      pendingCallEvent = outer;
+      return;
+    }
+    if (guard.isActive()) {
+      guard.before(name.c_str());
+    }
+    callFn();
+  } else {
+    callFn();
+  }
+}
+
+void PointwiseOperatorCompileResultImpl::set_backwards(
+    const std::vector<int> &gradInputs, const std::vector<int> &savedInputs,
+    py::object backward_compiler, int numScalars) {
+  auto backward = std::make_shared<CompiledBackward>();
+  backward->gradInputs = gradInputs;
+  backward->savedInputs = savedInputs;
+  backward->kernel = backward_compiler.cast<PointwiseOperatorCompileCache *>()
+                         ->unpackedCache(numScalars);
+  backward_ = std::move(backward);
+  backwardObject_ = std::move(backward_compiler);
+}
+
 torch::autograd::variable_list
 CompiledAutoGradNode::apply(torch::autograd::variable_list &&new_inputs) {
   // TODO(jansel): we likely need to copy some error checking from eager to
   // here
-  // TODO(jansel): possible optimization: horizontal fusion of each backwards
-  // fn
-  // TODO(jansel): possible optimization: reuse the forwards SpecializationKey
-  // TODO(jansel): possible optimization: dont save all the inputs_
+  // TODO(jansel): possible optimization: reuse the forwards SpecializationKey.
+  // The backward kernel specializes on the saved inputs plus the grad, so
+  // this needs the forward key stored on the node and extended by the grad.
   // TODO(jansel): possible optimization: precompute in forwards
-  torch::autograd::variable_list args;
-  args.reserve(inputs_.size() + 1);
-  std::copy(inputs_.begin(), inputs_.end(), std::back_inserter(args));
-  args.emplace_back(new_inputs[0]);
+  PointwiseOperatorCompileCache *kernel = backward_->kernel;
+  const int numIn = inputs_.size() + 1;
+  const int numOut = backward_->gradInputs.size();
+  c10::SmallVector<at::Tensor, 16> tensorArgs(numIn + numOut);
+  std::copy(inputs_.begin(), inputs_.end(), tensorArgs.begin());
+  tensorArgs[numIn - 1] = new_inputs[0];
+  recordCall(kernel->getName(), tensorArgs.data(), numIn,
+             [&] { kernel->callUnpacked(tensorArgs.data(), scalars_); });
+  return torch::autograd::variable_list(tensorArgs.begin() + numIn,
+                                        tensorArgs.end());
+}
+
+/// Wrap the outputs of a kernel call for python: a tensor for single output
+/// kernels, a tuple of tensors otherwise.
+static PyObject *wrapOutputs(const at::Tensor *outputs, int numOut) {
+  if (numOut == 1) {
+    return THPVariable_Wrap(outputs[0]);
+  }
+  py::tuple result(numOut);
+  for (int i = 0; i < numOut; ++i) {
+    result[i] = py::reinterpret_steal<py::object>(THPVariable_Wrap(outputs[i]));
+  }
+  return result.release().ptr();
+}
+
+/// Parse python args and run callFn(at::Tensor *tensorArgs) on the tensor
+/// arguments: numIn inputs, followed by numOut outputs.  If hasOut, the
+/// kernel takes an optional out argument, which fills in its single output.
+/// Shared by the kernel caches with a fixed and with a dynamic number of
+/// arguments.
+template <int MAX_ARGS, typename CallFn>
+static PyObject *pyCallImpl(PointwiseOperatorCompileCache *self,
+                            torch::PythonArgParser &parser,
+                            const std::string &name,
+                            const std::string &moduleName, int numIn,
+                            int numOut, bool hasOut, PyObject *args,
+                            PyObject *kwargs, const CallFn &callFn) {
+  torch::ParsedArgs<MAX_ARGS> parsed_args;
+  torch::PythonArgs r = parser.parse(args, kwargs, parsed_args);
+  if (C10_UNLIKELY(r.has_torch_function())) {
+    py::object op = py::cast(self);
+    return torch::handle_torch_function_no_python_arg_parser(
+        r.signature.overloaded_args, args, kwargs, name.c_str(), op.ptr(),
+        moduleName.c_str());
+  }
+  const int numArgs = hasOut ? numIn + 1 : numIn;
+  at::Tensor tensorArgs[MAX_ARGS]; // NOLINT: c-style arrays
+  for (int i = 0; i < numArgs; ++i) {
+    tensorArgs[i] = r.tensor(i);
+  }
+  recordCall(name, tensorArgs, numArgs, [&] { callFn(tensorArgs); });
+  return wrapOutputs(tensorArgs + numIn, numOut);
+}
 
-  torch::autograd::variable_list result;
-  result.reserve(backwards_functions_.size());
-  for (auto &bk : backwards_functions_) {
-    result.emplace_back(std::get<1>(bk)->call(args));
+/// Parse python args like pyCallImpl and run
+/// precompileFn(at::Tensor *tensorArgs) on the tensor arguments.
+template <int MAX_ARGS, typename PrecompileFn>
+static void pyPrecompileImpl(torch::PythonArgParser &parser,
+                             const std::string &name, int numIn, bool hasOut,
+                             PyObject *args, PyObject *kwargs,
+                             const PrecompileFn &precompileFn) {
+  torch::ParsedArgs<MAX_ARGS> parsed_args;
+  torch::PythonArgs r = parser.parse(args, kwargs, parsed_args);
+  TORCH_CHECK(!r.has_torch_function(), name,
+              ": precompiling with __torch_function__ overrides is not "
+              "supported");
+  const int numArgs = hasOut ? numIn + 1 : numIn;
+  at::Tensor tensorArgs[MAX_ARGS]; // NOLINT: c-style arrays
+  for (int i = 0; i < numArgs; ++i) {
+    tensorArgs[i] = r.tensor(i);
   }
-  return result;
+  precompileFn(tensorArgs);
 }
 
 /// Specialized kernel cache templated on the number of input
 /// and output arguments.  Uses ArgSpecializedCache to further
-/// specialize on whether kernels are out variants.
+/// specialize on whether kernels are out variants.  Only single output
+/// kernels have an out variant.
 template <int NUM_IN, int NUM_OUT = 1>
 struct InOutSpecializedCache : public PointwiseOperatorCompileCache {
   constexpr static int NUM_ARGS = NUM_IN + NUM_OUT;
-  constexpr static int LAST_ARG = NUM_ARGS - 1;
 
 public:
   /// Construct a kernel cache for a kernel with given name,
   /// module_name, and signatures, using a given compilation function.
+  /// Reduction kernels reduce over the last numReducedDims dims, and have no
+  /// out variant.
   InOutSpecializedCache(std::string name, std::string moduleName,
                         const std::vector<std::string> &signatures,
-                        const py::object &compileFn)
-      : cache_(compileFn), cacheOut_(compileFn), parser_(signatures),
-        name_(std::move(name)), moduleName_(std::move(moduleName_)) {
-    if (signatures.size() != 1) {
-      throw std::runtime_error("TODO: support overloaded signatures");
-    }
+                        const py::object &compileFn, int numReducedDims)
+      : cache_(compileFn, numReducedDims), cacheOut_(compileFn, 0),
+        parser_(signatures), name_(std::move(name)),
+        moduleName_(std::move(moduleName)),
+        hasOut_(NUM_OUT == 1 && numReducedDims == 0) {
+    // Overloads are handled by OverloadedCompileCache.
+    TORCH_INTERNAL_ASSERT(signatures.size() == 1);
   }
 
   /// Returns name of kernel.
@@ -739,50 +1985,220 @@ public:
 
   /// Call kernel using python objects.
   PyObject *pyCall(PyObject *args, PyObject *kwargs) {
-    torch::ParsedArgs<NUM_ARGS> parsed_args;
-    torch::PythonArgs r = parser_.parse(args, kwargs, parsed_args);
-    bool presampled = false;
-    if (C10_UNLIKELY(r.has_torch_function())) {
-      py::object op =
-          py::cast(static_cast<PointwiseOperatorCompileCache *>(this));
-      return torch::handle_torch_function_no_python_arg_parser(
-          r.signature.overloaded_args, args, kwargs, name_.c_str(), op.ptr(),
-          moduleName_.c_str());
-    } else if (C10_UNLIKELY(at::hasCallbacks() &&
-                            at::shouldRunRecordFunction(&presampled))) {
-      throw std::runtime_error("TODO: implement record function");
+    return pyCallImpl<NUM_ARGS>(
+        this, parser_, name_, moduleName_, NUM_IN, NUM_OUT, hasOut_, args,
+        kwargs,
+        [this](at::Tensor *tensorArgs) {
+          callUnpacked(tensorArgs, ScalarArgs());
+        });
+  }
+
+  /// Call kernel with unpacked args.
+  void callUnpacked(at::Tensor *tensorArgs, const ScalarArgs &scalars) {
+    if (hasOut_ && tensorArgs[NUM_IN].defined()) {
+      cacheOut_.call(tensorArgs, scalars);
     } else {
-      at::Tensor tensorArgs[NUM_ARGS]; // NOLINT: c-style arrays
-      for (int i = 0; i < NUM_ARGS; ++i) {
-        tensorArgs[i] = r.tensor(i);
-      }
-      if (tensorArgs[LAST_ARG].defined()) {
-        cacheOut_.call(tensorArgs);
-      } else {
-        cache_.call(tensorArgs);
-      }
-      return THPVariable_Wrap(tensorArgs[LAST_ARG]);
+      cache_.call(tensorArgs, scalars);
+    }
+  }
+
+  /// Compile kernel for a call using python objects.
+  void pyPrecompile(PyObject *args, PyObject *kwargs) {
+    pyPrecompileImpl<NUM_ARGS>(
+        parser_, name_, NUM_IN, hasOut_, args, kwargs,
+        [this](at::Tensor *tensorArgs) { precompileUnpacked(tensorArgs); });
+  }
+
+  /// Compile kernel for a call with unpacked args.
+  void precompileUnpacked(at::Tensor *tensorArgs) {
+    if (hasOut_ && tensorArgs[NUM_IN].defined()) {
+      cacheOut_.precompile(tensorArgs);
+    } else {
+      cache_.precompile(tensorArgs);
     }
   }
 
-  /// Call kernel using vector of tensors.
-  at::Tensor call(const std::vector<at::Tensor> &args) {
+  /// Compile kernel for a record listed by cachedKernels.
+  void precompileRecord(const py::dict &record) {
+    if (record["out"].cast<bool>()) {
+      TORCH_CHECK(hasOut_, "malformed kernel record: out=True");
+      cacheOut_.precompileRecord(record);
+    } else {
+      cache_.precompileRecord(record);
+    }
+  }
+
+  /// Append a record of every cached kernel to records.
+  void cachedKernels(py::list &records, const py::dict &route) const {
+    cache_.cachedKernels(records, withField(route, "out", py::bool_(false)));
+    cacheOut_.cachedKernels(records, withField(route, "out", py::bool_(true)));
+  }
+
+  /// Call kernel using vector of tensors, returning its outputs.
+  std::vector<at::Tensor> call(const std::vector<at::Tensor> &args) {
     if (C10_UNLIKELY(args.size() != NUM_IN)) {
       throw std::runtime_error("wrong number of args");
     }
+    RECORD_FUNCTION(name_.c_str(), definedInputs(args.data(), NUM_IN));
     at::Tensor tensorArgs[NUM_ARGS]; // NOLINT: c-style arrays
     std::copy(args.begin(), args.end(), tensorArgs);
-    py::gil_scoped_acquire guard; // we protect our cache w/ GIL
-    cache_.call(tensorArgs);
-    return tensorArgs[LAST_ARG];
+    // Cache hits don't need the GIL; misses take it to compile.
+    cache_.call(tensorArgs, ScalarArgs());
+    return std::vector<at::Tensor>(tensorArgs + NUM_IN, tensorArgs + NUM_ARGS);
   }
 
 private:
   /// Cache for kernel that allocates its output.
   ArgSpecializedCache<ArgCounts<NUM_IN, NUM_OUT, 0>> cache_;
 
-  /// Cache for out-variant kernel, which has output provided.
-  ArgSpecializedCache<ArgCounts<NUM_IN, 0, NUM_OUT>> cacheOut_;
+  /// Cache for out-variant kernel, which has output provided. Only used by
+  /// single output kernels.
+  ArgSpecializedCache<ArgCounts<NUM_IN, 0, 1>> cacheOut_;
+
+  /// Parser for kernel args.
+  torch::PythonArgParser parser_;
+
+  /// Name of kernel.
+  std::string name_;
+
+  /// Module name of kernel.
+  std::string moduleName_;
+
+  /// Whether the kernel takes an out argument.
+  bool hasOut_;
+};
+
+/// Kernel cache for kernels with more inputs or outputs than the
+/// InOutSpecializedCache instantiations cover (see createInOutCache).
+struct DynamicInOutCache : public PointwiseOperatorCompileCache {
+  /// Max number of arguments, including the outputs.
+  static constexpr int kMaxArgs = 64;
+
+  /// Construct a kernel cache for a kernel with given name,
+  /// module_name, and signatures, using a given compilation function.
+  /// Reduction kernels reduce over the last numReducedDims dims, and have no
+  /// out variant.
+  DynamicInOutCache(std::string name, std::string moduleName,
+                    const std::vector<std::string> &signatures,
+                    const py::object &compileFn, int numIn, int numOut,
+                    int numReducedDims)
+      : numIn_(numIn), numOut_(numOut), numReducedDims_(numReducedDims),
+        cache_(compileFn, numIn, numOut, 0), cacheOut_(compileFn, numIn, 0, 1),
+        parser_(signatures), name_(std::move(name)),
+        moduleName_(std::move(moduleName)) {
+    if (numIn + numOut > kMaxArgs) {
+      throw std::runtime_error("pointwise operators support at most " +
+                               std::to_string(kMaxArgs) +
+                               " inputs and outputs");
+    }
+    // Overloads are handled by OverloadedCompileCache.
+    TORCH_INTERNAL_ASSERT(signatures.size() == 1);
+  }
+
+  /// Returns name of kernel.
+  const std::string &getName() const { return name_; }
+
+  /// Call kernel using python objects.
+  PyObject *pyCall(PyObject *args, PyObject *kwargs) {
+    return pyCallImpl<kMaxArgs>(
+        this, parser_, name_, moduleName_, numIn_, numOut_, hasOut(), args,
+        kwargs,
+        [this](at::Tensor *tensorArgs) {
+          callUnpacked(tensorArgs, ScalarArgs());
+        });
+  }
+
+  /// Call kernel with unpacked args.
+  void callUnpacked(at::Tensor *tensorArgs, const ScalarArgs &scalars) {
+    if (hasOut() && tensorArgs[numIn_].defined()) {
+      call(cacheOut_, numIn_ + 1, numIn_ + 1, 0, tensorArgs, scalars);
+    } else {
+      call(cache_, numIn_, numIn_ + numOut_, numReducedDims_, tensorArgs,
+           scalars);
+    }
+  }
+
+  /// Compile kernel for a call using python objects.
+  void pyPrecompile(PyObject *args, PyObject *kwargs) {
+    pyPrecompileImpl<kMaxArgs>(
+        parser_, name_, numIn_, hasOut(), args, kwargs,
+        [this](at::Tensor *tensorArgs) { precompileUnpacked(tensorArgs); });
+  }
+
+  /// Compile kernel for a call with unpacked args.
+  void precompileUnpacked(at::Tensor *tensorArgs) {
+    if (hasOut() && tensorArgs[numIn_].defined()) {
+      precompile(cacheOut_, numIn_ + 1, numIn_ + 1, 0, tensorArgs);
+    } else {
+      precompile(cache_, numIn_, numIn_ + numOut_, numReducedDims_,
+                 tensorArgs);
+    }
+  }
+
+  /// Compile kernel for a record listed by cachedKernels.
+  void precompileRecord(const py::dict &record) {
+    if (record["out"].cast<bool>()) {
+      TORCH_CHECK(hasOut(), "malformed kernel record: out=True");
+      cacheOut_.precompileRecord(record);
+    } else {
+      cache_.precompileRecord(record);
+    }
+  }
+
+  /// Append a record of every cached kernel to records.
+  void cachedKernels(py::list &records, const py::dict &route) const {
+    cache_.cachedKernels(records, withField(route, "out", py::bool_(false)));
+    cacheOut_.cachedKernels(records, withField(route, "out", py::bool_(true)));
+  }
+
+  /// Call kernel using vector of tensors, returning its outputs.
+  std::vector<at::Tensor> call(const std::vector<at::Tensor> &args) {
+    if (C10_UNLIKELY(args.size() != numIn_)) {
+      throw std::runtime_error("wrong number of args");
+    }
+    RECORD_FUNCTION(name_.c_str(), definedInputs(args.data(), numIn_));
+    c10::SmallVector<at::Tensor, 16> tensorArgs(numIn_ + numOut_);
+    std::copy(args.begin(), args.end(), tensorArgs.begin());
+    call(cache_, numIn_, numIn_ + numOut_, numReducedDims_, tensorArgs.data(),
+         ScalarArgs());
+    return std::vector<at::Tensor>(tensorArgs.begin() + numIn_,
+                                   tensorArgs.end());
+  }
+
+private:
+  /// Whether the kernel takes an out argument.
+  bool hasOut() const { return numOut_ == 1 && numReducedDims_ == 0; }
+
+  /// Call a kernel from cache with args, after collapsing dims.
+  void call(DynamicArgCache &cache, int numKeys, int numBuffers,
+            int numReducedDims, at::Tensor *args, const ScalarArgs &scalars) {
+    c10::SmallVector<at::Tensor, 16> collapsed(numBuffers);
+    callWithCollapsedDims(
+        args, numKeys, numBuffers, numReducedDims, collapsed.data(),
+        [&cache, &scalars](at::Tensor *a) { cache.call(a, scalars); });
+  }
+
+  /// Compile a kernel for args, after collapsing dims, unless cached.
+  void precompile(DynamicArgCache &cache, int numKeys, int numBuffers,
+                  int numReducedDims, at::Tensor *args) {
+    c10::SmallVector<at::Tensor, 16> collapsed(numBuffers);
+    callWithCollapsedDims(args, numKeys, numBuffers, numReducedDims,
+                          collapsed.data(),
+                          [&cache](at::Tensor *a) { cache.precompile(a); });
+  }
+
+  int numIn_;
+  int numOut_;
+
+  /// Number of trailing dims the kernel reduces over.
+  int numReducedDims_;
+
+  /// Cache for kernel that allocates its outputs.
+  DynamicArgCache cache_;
+
+  /// Cache for out-variant kernel, which has output provided. Only used by
+  /// single output kernels.
+  DynamicArgCache cacheOut_;
 
   /// Parser for kernel args.
   torch::PythonArgParser parser_;
@@ -794,31 +2210,450 @@ private:
   std::string moduleName_;
 };
 
-/// Create a PointwiseOperatorCompileCache with the given number of arguments.
+/// Max number of inputs of kernels using InOutSpecializedCache.
+static constexpr int kMaxSpecializedInputs = 8;
+
+/// Max number of outputs of kernels using InOutSpecializedCache, which covers
+/// the fused backward kernels of operators with up to this many inputs.
+static constexpr int kMaxSpecializedOutputs = 4;
+
+/// Create an InOutSpecializedCache with NUM_OUT outputs and numArgs inputs,
+/// or return nullptr if numArgs is not in 1..kMaxSpecializedInputs.
+template <int NUM_OUT>
 static PointwiseOperatorCompileCache *
-createCompileCache(const std::string &name, const std::string &moduleName,
-                   const std::vector<std::string> &sig,
-                   const py::object &compileFn, int numArgs) {
+createSpecializedCache(const std::string &name, const std::string &moduleName,
+                       const std::vector<std::string> &sig,
+                       const py::object &compileFn, int numArgs,
+                       int numReducedDims) {
+  static_assert(kMaxSpecializedInputs == 8, "update the cases below");
   switch (numArgs) {
   case 1:
-    return new InOutSpecializedCache<1>(name, moduleName, sig, compileFn);
+    return new InOutSpecializedCache<1, NUM_OUT>(name, moduleName, sig,
+                                                 compileFn, numReducedDims);
   case 2:
-    return new InOutSpecializedCache<2>(name, moduleName, sig, compileFn);
+    return new InOutSpecializedCache<2, NUM_OUT>(name, moduleName, sig,
+                                                 compileFn, numReducedDims);
   case 3:
-    return new InOutSpecializedCache<3>(name, moduleName, sig, compileFn);
+    return new InOutSpecializedCache<3, NUM_OUT>(name, moduleName, sig,
+                                                 compileFn, numReducedDims);
   case 4:
-    return new InOutSpecializedCache<4>(name, moduleName, sig, compileFn);
+    return new InOutSpecializedCache<4, NUM_OUT>(name, moduleName, sig,
+                                                 compileFn, numReducedDims);
   case 5:
-    return new InOutSpecializedCache<5>(name, moduleName, sig, compileFn);
+    return new InOutSpecializedCache<5, NUM_OUT>(name, moduleName, sig,
+                                                 compileFn, numReducedDims);
   case 6:
-    return new InOutSpecializedCache<6>(name, moduleName, sig, compileFn);
+    return new InOutSpecializedCache<6, NUM_OUT>(name, moduleName, sig,
+                                                 compileFn, numReducedDims);
   case 7:
-    return new InOutSpecializedCache<7>(name, moduleName, sig, compileFn);
+    return new InOutSpecializedCache<7, NUM_OUT>(name, moduleName, sig,
+                                                 compileFn, numReducedDims);
   case 8:
-    return new InOutSpecializedCache<8>(name, moduleName, sig, compileFn);
+    return new InOutSpecializedCache<8, NUM_OUT>(name, moduleName, sig,
+                                                 compileFn, numReducedDims);
   default:
-    throw std::runtime_error("TODO: support other arg counts");
+    return nullptr;
+  }
+}
+
+/// Create a kernel cache for an operator with a single signature taking
+/// numArgs tensors and returning numOutputs tensors, reduced over the last
+/// numReducedDims dims.  Kernels with more inputs or outputs than
+/// InOutSpecializedCache covers use DynamicInOutCache, whose calls take the
+/// GIL.
+static PointwiseOperatorCompileCache *
+createInOutCache(const std::string &name, const std::string &moduleName,
+                 const std::vector<std::string> &sig,
+                 const py::object &compileFn, int numArgs, int numOutputs,
+                 int numReducedDims) {
+  static_assert(kMaxSpecializedOutputs == 4, "update the cases below");
+  PointwiseOperatorCompileCache *cache = nullptr;
+  switch (numOutputs) {
+  case 1:
+    cache = createSpecializedCache<1>(name, moduleName, sig, compileFn,
+                                      numArgs, numReducedDims);
+    break;
+  case 2:
+    cache = createSpecializedCache<2>(name, moduleName, sig, compileFn,
+                                      numArgs, numReducedDims);
+    break;
+  case 3:
+    cache = createSpecializedCache<3>(name, moduleName, sig, compileFn,
+                                      numArgs, numReducedDims);
+    break;
+  case 4:
+    cache = createSpecializedCache<4>(name, moduleName, sig, compileFn,
+                                      numArgs, numReducedDims);
+    break;
+  default:
+    break;
+  }
+  if (cache != nullptr) {
+    return cache;
+  }
+  return new DynamicInOutCache(name, moduleName, sig, compileFn, numArgs,
+                               numOutputs, numReducedDims);
+}
+
+/// Kind of an argument of an operator with scalar arguments.
+enum class PointwiseArgKind {
+  /// Tensor, specialized on by SpecializationKey.
+  Tensor,
+
+  /// Python float, passed to the kernel as a double parameter.
+  Double,
+
+  /// Python int, passed to the kernel as an int64_t parameter.
+  Int,
+
+  /// Python float, compiled into the kernel as a constant.
+  SpecializedDouble,
+
+  /// Python int, compiled into the kernel as a constant.
+  SpecializedInt,
+};
+
+/// Kernel cache for operators with scalar arguments or overloaded
+/// signatures.  Each signature (overload) gives the kind of each of its
+/// arguments.  A call passes the tensors to a kernel cache for the overload
+/// and the values of the specialized scalars, and the other scalars to the
+/// kernel as parameters.  Kernels are compiled by
+/// compileFn(spec, result, overload=i, specialized=values).
+struct OverloadedCompileCache : public PointwiseOperatorCompileCache {
+  /// Max number of arguments, including the outputs.
+  static constexpr int kMaxArgs = 64;
+
+  /// Construct a kernel cache for a kernel with given name, module_name,
+  /// and signatures with the given argument kinds, using a given compilation
+  /// function.  Reduction kernels reduce over the last numReducedDims dims,
+  /// and have no out variant.
+  OverloadedCompileCache(
+      std::string name, std::string moduleName,
+      const std::vector<std::string> &signatures, py::object compileFn,
+      const std::vector<std::vector<PointwiseArgKind>> &argKinds,
+      int numOutputs, int numReducedDims)
+      : parser_(signatures), name_(std::move(name)),
+        moduleName_(std::move(moduleName)), compileFn_(std::move(compileFn)),
+        numOutputs_(numOutputs), numReducedDims_(numReducedDims) {
+    TORCH_CHECK(signatures.size() == argKinds.size(),
+                "expected the argument kinds of every signature");
+    for (size_t i = 0; i < signatures.size(); ++i) {
+      Overload overload;
+      overload.signature = signatures[i];
+      overload.kinds = argKinds[i];
+      int numScalars = 0;
+      for (PointwiseArgKind kind : overload.kinds) {
+        if (kind == PointwiseArgKind::Tensor) {
+          ++overload.numTensors;
+        } else if (kind == PointwiseArgKind::Double ||
+                   kind == PointwiseArgKind::Int) {
+          ++numScalars;
+        }
+      }
+      TORCH_CHECK(overload.numTensors > 0,
+                  "pointwise operators need a tensor argument");
+      TORCH_CHECK(overload.numTensors + numOutputs <= kMaxArgs,
+                  "pointwise operators support at most ", kMaxArgs,
+                  " inputs and outputs");
+      TORCH_CHECK(numScalars <= ScalarArgs::kMax,
+                  "pointwise operators support at most ", ScalarArgs::kMax,
+                  " unspecialized scalar arguments");
+      overloads_.emplace_back(std::move(overload));
+    }
+    for (auto &cache : unspecializedCaches_) {
+      cache.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  /// Returns name of kernel.
+  const std::string &getName() const { return name_; }
+
+  /// Call kernel using python objects.
+  PyObject *pyCall(PyObject *args, PyObject *kwargs) {
+    torch::ParsedArgs<kMaxArgs> parsed_args;
+    torch::PythonArgs r = parser_.parse(args, kwargs, parsed_args);
+    if (C10_UNLIKELY(r.has_torch_function())) {
+      py::object op =
+          py::cast(static_cast<PointwiseOperatorCompileCache *>(this));
+      return torch::handle_torch_function_no_python_arg_parser(
+          r.signature.overloaded_args, args, kwargs, name_.c_str(), op.ptr(),
+          moduleName_.c_str());
+    }
+    at::Tensor tensorArgs[kMaxArgs]; // NOLINT: c-style arrays
+    ScalarArgs scalars;
+    PointwiseOperatorCompileCache *cache = unpack(r, tensorArgs, scalars);
+    const int numIn = overloads_[r.idx].numTensors;
+    recordCall(name_, tensorArgs, numIn + 1,
+               [&] { cache->callUnpacked(tensorArgs, scalars); });
+    return wrapOutputs(tensorArgs + numIn, numOutputs_);
+  }
+
+  /// Compile kernel for a call using python objects.
+  void pyPrecompile(PyObject *args, PyObject *kwargs) {
+    torch::ParsedArgs<kMaxArgs> parsed_args;
+    torch::PythonArgs r = parser_.parse(args, kwargs, parsed_args);
+    TORCH_CHECK(!r.has_torch_function(), name_,
+                ": precompiling with __torch_function__ overrides is not "
+                "supported");
+    at::Tensor tensorArgs[kMaxArgs]; // NOLINT: c-style arrays
+    ScalarArgs scalars;
+    unpack(r, tensorArgs, scalars)->precompileUnpacked(tensorArgs);
+  }
+
+  /// Call kernel using vector of tensors, returning its outputs.  Uses the
+  /// overload taking only tensors.
+  std::vector<at::Tensor> call(const std::vector<at::Tensor> &args) {
+    return unspecializedCache(0)->call(args);
+  }
+
+  /// Call kernel with unpacked args.  Uses the overload with scalars.size
+  /// scalar args, none of them specialized, which must be unique.
+  void callUnpacked(at::Tensor *tensorArgs, const ScalarArgs &scalars) {
+    unspecializedCache(scalars.size)->callUnpacked(tensorArgs, scalars);
+  }
+
+  /// Compile kernel for a call with unpacked args.  Uses the overload taking
+  /// only tensors, which must be unique.
+  void precompileUnpacked(at::Tensor *tensorArgs) {
+    unspecializedCache(0)->precompileUnpacked(tensorArgs);
+  }
+
+  /// The kernel cache that callUnpacked forwards calls with numScalars
+  /// scalar args to.
+  PointwiseOperatorCompileCache *unpackedCache(int numScalars) {
+    TORCH_CHECK(numScalars >= 0 && numScalars <= ScalarArgs::kMax, name_,
+                ": too many scalar args");
+    return unspecializedCache(numScalars);
+  }
+
+  /// Compile kernel for a record listed by cachedKernels.
+  void precompileRecord(const py::dict &record) {
+    int index = record["overload"].cast<int>();
+    TORCH_CHECK(index >= 0 && static_cast<size_t>(index) < overloads_.size(),
+                "malformed kernel record: overload=", index);
+    Overload &overload = overloads_[index];
+    std::string specialized = record["specialized"].cast<std::string>();
+    size_t numSpecialized = 0;
+    for (PointwiseArgKind kind : overload.kinds) {
+      numSpecialized += kind == PointwiseArgKind::SpecializedDouble ||
+                        kind == PointwiseArgKind::SpecializedInt;
+    }
+    TORCH_CHECK(specialized.size() == numSpecialized * 8,
+                "malformed kernel record: specialized values");
+    cacheFor(overload, index, specialized)->precompileRecord(record);
+  }
+
+  /// Append a record of every cached kernel to records.
+  void cachedKernels(py::list &records, const py::dict &route) const {
+    for (size_t i = 0; i < overloads_.size(); ++i) {
+      py::dict overloadRoute = withField(route, "overload", py::int_(i));
+      for (const auto &item : overloads_[i].caches) {
+        item.second->cachedKernels(
+            records,
+            withField(overloadRoute, "specialized", py::bytes(item.first)));
+      }
+    }
+  }
+
+private:
+  struct Overload {
+    /// Signature of this overload.
+    std::string signature;
+
+    /// Kind of each argument, excluding the out argument.
+    std::vector<PointwiseArgKind> kinds;
+
+    /// Number of tensor arguments, excluding the outputs.
+    int numTensors = 0;
+
+    /// Kernel caches of this overload, by the bytes of the values of the
+    /// specialized scalars.
+    std::unordered_map<std::string,
+                       std::unique_ptr<PointwiseOperatorCompileCache>>
+        caches;
+  };
+
+  /// Index of the single overload for which matches(overload) holds, which
+  /// takes the args described by expected.
+  template <typename Matches>
+  int findOverload(const Matches &matches, const char *expected) const {
+    int index = -1;
+    for (size_t i = 0; i < overloads_.size(); ++i) {
+      if (matches(overloads_[i])) {
+        TORCH_CHECK(index < 0, name_, ": more than one overload takes ",
+                    expected);
+        index = i;
+      }
+    }
+    TORCH_CHECK(index >= 0, name_, ": no overload takes ", expected);
+    return index;
+  }
+
+  /// Kernel cache of the single overload taking numScalars scalar args that
+  /// are passed to the kernel as parameters, and no specialized ones, for
+  /// calls with unpacked args.  Only the first call for numScalars takes the
+  /// GIL, which protects the caches of overloads, to look it up.
+  PointwiseOperatorCompileCache *unspecializedCache(int numScalars) {
+    PointwiseOperatorCompileCache *cache =
+        unspecializedCaches_[numScalars].load(std::memory_order_acquire);
+    if (C10_LIKELY(cache != nullptr)) {
+      return cache;
+    }
+    py::gil_scoped_acquire guard;
+    cache = unspecializedCaches_[numScalars].load(std::memory_order_relaxed);
+    if (cache != nullptr) {
+      return cache;
+    }
+    int index = findOverload(
+        [numScalars](const Overload &overload) {
+          int numUnspecialized = 0;
+          for (PointwiseArgKind kind : overload.kinds) {
+            if (kind == PointwiseArgKind::SpecializedDouble ||
+                kind == PointwiseArgKind::SpecializedInt) {
+              return false;
+            }
+            numUnspecialized += kind != PointwiseArgKind::Tensor;
+          }
+          return numUnspecialized == numScalars;
+        },
+        numScalars == 0 ? "only tensors"
+                        : "that many unspecialized scalar args");
+    // Caches of overloads are never removed, so the pointer stays valid.
+    cache = cacheFor(overloads_[index], index, std::string());
+    unspecializedCaches_[numScalars].store(cache, std::memory_order_release);
+    return cache;
+  }
+
+  /// Unpack the parsed args of a call into the tensor args, followed by the
+  /// out argument, and the unspecialized scalars.  Returns the kernel cache
+  /// of the overload for the values of the specialized scalars.  Needs the
+  /// GIL, which protects the caches of overloads.
+  PointwiseOperatorCompileCache *unpack(torch::PythonArgs &r,
+                                        at::Tensor *tensorArgs,
+                                        ScalarArgs &scalars) {
+    Overload &overload = overloads_[r.idx];
+    std::string specialized;
+    int numIn = 0;
+    for (size_t i = 0; i < overload.kinds.size(); ++i) {
+      switch (overload.kinds[i]) {
+      case PointwiseArgKind::Tensor:
+        tensorArgs[numIn++] = r.tensor(i);
+        break;
+      case PointwiseArgKind::Double: {
+        double value = r.toDouble(i);
+        memcpy(&scalars.slots[scalars.size++], &value, sizeof(double));
+        break;
+      }
+      case PointwiseArgKind::Int:
+        scalars.slots[scalars.size++] = r.toInt64(i);
+        break;
+      case PointwiseArgKind::SpecializedDouble: {
+        double value = r.toDouble(i);
+        specialized.append(reinterpret_cast<const char *>(&value),
+                           sizeof(double));
+        break;
+      }
+      case PointwiseArgKind::SpecializedInt: {
+        int64_t value = r.toInt64(i);
+        specialized.append(reinterpret_cast<const char *>(&value),
+                           sizeof(int64_t));
+        break;
+      }
+      }
+    }
+    if (numOutputs_ == 1 && numReducedDims_ == 0) {
+      tensorArgs[numIn] = r.tensor(overload.kinds.size());
+    }
+    return cacheFor(overload, r.idx, specialized);
   }
+
+  /// Get the kernel cache for the specialized scalar values of a call to
+  /// overload number index, creating it if needed.
+  PointwiseOperatorCompileCache *cacheFor(Overload &overload, int index,
+                                          const std::string &specialized) {
+    auto item = overload.caches.find(specialized);
+    if (C10_LIKELY(item != overload.caches.end())) {
+      return item->second.get();
+    }
+    // Every specialized value takes 8 bytes.
+    py::tuple values(specialized.size() / 8);
+    size_t i = 0;
+    for (PointwiseArgKind kind : overload.kinds) {
+      const char *bytes = specialized.data() + i * 8;
+      if (kind == PointwiseArgKind::SpecializedDouble) {
+        double value;
+        memcpy(&value, bytes, sizeof(double));
+        values[i++] = py::float_(value);
+      } else if (kind == PointwiseArgKind::SpecializedInt) {
+        int64_t value;
+        memcpy(&value, bytes, sizeof(int64_t));
+        values[i++] = py::int_(value);
+      }
+    }
+    py::object partial = py::module_::import("functools").attr("partial");
+    py::object compileFn = partial(compileFn_, py::arg("overload") = index,
+                                   py::arg("specialized") = values);
+    std::unique_ptr<PointwiseOperatorCompileCache> cache(
+        createInOutCache(name_, moduleName_, {overload.signature}, compileFn,
+                         overload.numTensors, numOutputs_, numReducedDims_));
+    PointwiseOperatorCompileCache *result = cache.get();
+    overload.caches.emplace(specialized, std::move(cache));
+    return result;
+  }
+
+  /// Parser for kernel args.
+  torch::PythonArgParser parser_;
+
+  /// Name of kernel.
+  std::string name_;
+
+  /// Module name of kernel.
+  std::string moduleName_;
+
+  /// The compilation function of all overloads.
+  py::object compileFn_;
+
+  int numOutputs_;
+
+  /// Number of trailing dims the kernel reduces over.
+  int numReducedDims_;
+
+  std::vector<Overload> overloads_;
+
+  /// Kernel caches for calls with unpacked args, by number of scalar args,
+  /// or null if not looked up yet (see unspecializedCache).
+  std::array<std::atomic<PointwiseOperatorCompileCache *>,
+             ScalarArgs::kMax + 1>
+      unspecializedCaches_;
+};
+
+/// Convert an optional python dtype.
+static c10::optional<at::ScalarType>
+toOptionalScalarType(const py::object &dtype) {
+  if (dtype.is_none()) {
+    return c10::nullopt;
+  }
+  TORCH_CHECK(THPDtype_Check(dtype.ptr()), "expected a torch.dtype");
+  return reinterpret_cast<THPDtype *>(dtype.ptr())->scalar_type;
+}
+
+/// Create a PointwiseOperatorCompileCache for an operator with the given
+/// signatures, taking numArgs arguments and returning numOutputs tensors.
+/// argKinds gives the kind of each argument of each signature; if empty,
+/// there is a single signature, taking only tensors.  Reduction kernels
+/// reduce over the last numReducedDims dims.
+static PointwiseOperatorCompileCache *
+createCompileCache(const std::string &name, const std::string &moduleName,
+                   const std::vector<std::string> &sig,
+                   const py::object &compileFn, int numArgs, int numOutputs,
+                   const std::vector<std::vector<PointwiseArgKind>> &argKinds,
+                   int numReducedDims) {
+  if (argKinds.empty()) {
+    return createInOutCache(name, moduleName, sig, compileFn, numArgs,
+                            numOutputs, numReducedDims);
+  }
+  return new OverloadedCompileCache(name, moduleName, sig, compileFn, argKinds,
+                                    numOutputs, numReducedDims);
 }
 } // namespace
 
@@ -828,18 +2663,44 @@ namespace functorch {
 void initPointwiseOperatorCompileCacheBindings(PyObject *module) {
   py::handle te(module);
 
+  py::enum_<PointwiseArgKind>(te, "PointwiseArgKind")
+      .value("Tensor", PointwiseArgKind::Tensor)
+      .value("Double", PointwiseArgKind::Double)
+      .value("Int", PointwiseArgKind::Int)
+      .value("SpecializedDouble", PointwiseArgKind::SpecializedDouble)
+      .value("SpecializedInt", PointwiseArgKind::SpecializedInt);
+
   py::class_<PointwiseOperatorCompileCache>(te, "PointwiseOperatorCompileCache")
-      .def(py::init(&createCompileCache))
+      .def(py::init(&createCompileCache), py::arg("name"),
+           py::arg("module_name"), py::arg("signatures"),
+           py::arg("compile_fn"), py::arg("num_args"), py::arg("num_outputs"),
+           py::arg("arg_kinds"), py::arg("num_reduced_dims") = 0)
       .def("__call__", [](PointwiseOperatorCompileCache &self, py::args args,
                           py::kwargs kwargs) {
         return py::reinterpret_steal<py::object>(
             self.pyCall(args.ptr(), kwargs.ptr()));
+      })
+      .def("_precompile",
+           [](PointwiseOperatorCompileCache &self, py::args args,
+              py::kwargs kwargs) {
+             self.pyPrecompile(args.ptr(), kwargs.ptr());
+           })
+      .def("_precompile_record",
+           &PointwiseOperatorCompileCache::precompileRecord)
+      .def("_cached_kernels", [](const PointwiseOperatorCompileCache &self) {
+        py::list records;
+        self.cachedKernels(records, py::dict());
+        return records;
       });
 
   py::class_<PoinwiseOperatorCompileResultProxy>(
       te, "PointwiseOperatorCompileResult")
       .def("set_code", [](PoinwiseOperatorCompileResultProxy &self,
                           const py::object &cg) { self.res->setCode(cg); })
+      .def("set_spec_summary",
+           [](PoinwiseOperatorCompileResultProxy &self, std::string summary) {
+             self.res->setSpecSummary(std::move(summary));
+           })
       .def("add_shape_check",
            [](PoinwiseOperatorCompileResultProxy &self,
               const std::tuple<int, int, int, int> &indices) {
@@ -855,15 +2716,27 @@ void initPointwiseOperatorCompileCacheBindings(PyObject *module) {
               const std::vector<std::pair<int, int>> &indices) {
              self.res->setStrideArgsFrom(indices);
            })
-      .def("add_allocated_output",
-           [](PoinwiseOperatorCompileResultProxy &self, int optionsFrom,
-              const std::vector<int> &storageOrder) {
-             self.res->addAllocatedOutput(optionsFrom, storageOrder);
-           })
-      .def("set_backwards", [](PoinwiseOperatorCompileResultProxy &self,
-                               int index, py::object backward_compiler) {
-        self.res->set_backwards(index, backward_compiler);
-      });
+      .def(
+          "add_allocated_output",
+          [](PoinwiseOperatorCompileResultProxy &self, int optionsFrom,
+             const std::vector<int> &storageOrder, const py::object &dtype,
+             const py::object &resultDtype) {
+            self.res->addAllocatedOutput(optionsFrom, storageOrder,
+                                         toOptionalScalarType(dtype),
+                                         toOptionalScalarType(resultDtype));
+          },
+          py::arg("options_from"), py::arg("storage_order"),
+          py::arg("dtype") = py::none(), py::arg("result_dtype") = py::none())
+      .def("set_backwards",
+           [](PoinwiseOperatorCompileResultProxy &self,
+              const std::vector<int> &gradInputs,
+              const std::vector<int> &savedInputs,
+              py::object backward_compiler, int numScalars) {
+             self.res->set_backwards(gradInputs, savedInputs,
+                                     std::move(backward_compiler), numScalars);
+           },
+           py::arg("grad_inputs"), py::arg("saved_inputs"),
+           py::arg("backward_compiler"), py::arg("num_scalars") = 0);
 }
 
 } // namespace functorch
@@ -58,16 +58,12 @@ void dumpTensorCout(const Tensor& tensor) {
   std::cout << std::endl;
 }
 
-c10::intrusive_ptr<TensorWrapper> makeTensorWrapperPtr(const Tensor& tensor, int64_t level, bool should_be_alive) {
+c10::intrusive_ptr<TensorWrapper> makeTensorWrapperPtr(const Tensor& tensor, int64_t level, uint64_t generation) {
   auto keys_to_propagate = kKeysToPropagateToWrapper | DispatchKeySet({
       DispatchKey::AutogradCPU, DispatchKey::AutogradCUDA, DispatchKey::AutogradXLA});
   auto key_set = getKeysToPropagateToWrapper(tensor, keys_to_propagate);
   key_set = key_set.add(kGradWrapperKey);
-  if (should_be_alive) {
-    return c10::make_intrusive<TensorWrapper>(key_set, tensor, level, getLifeHandleForLevel(level));
-  } else {
-    return c10::make_intrusive<TensorWrapper>(key_set, tensor, level, std::make_shared<bool>(false));
-  }
+  return c10::make_intrusive<TensorWrapper>(key_set, tensor, level, generation);
 }
 
 Tensor makeTensorWrapper(const Tensor& tensor, int64_t level) {
@@ -80,20 +76,20 @@ Tensor makeTensorWrapper(const Tensor& tensor, int64_t level) {
       DispatchKey::AutogradCPU, DispatchKey::AutogradCUDA, DispatchKey::AutogradXLA});
   auto key_set = getKeysToPropagateToWrapper(tensor, keys_to_propagate);
   key_set = key_set.add(kGradWrapperKey);
-  auto life_handle = getLifeHandleForLevel(level);
-  auto result = at::detail::make_tensor<TensorWrapper>(key_set, tensor, level, std::move(life_handle));
+  auto generation = getGenerationForLevel(level);
+  auto result = at::detail::make_tensor<TensorWrapper>(key_set, tensor, level, generation);
   TORCH_INTERNAL_ASSERT(result.key_set().has(kGradWrapperKey));
   return result;
 }
 
 bool TensorWrapper::is_alive() const {
-  return *is_alive_;
+  return isLevelAlive(level_, generation_);
 }
 
 c10::intrusive_ptr<TensorImpl> TensorWrapper::shallow_copy_and_detach(
     const c10::VariableVersion& version_counter,
     bool allow_tensor_metadata_change) const {
-  auto dest_impl = makeTensorWrapperPtr(value(), level_, is_alive());
+  auto dest_impl = makeTensorWrapperPtr(value(), level_, generation_);
   dest_impl->set_version_counter(version_counter);
 
   // TODO: is this even right?
@@ -104,7 +100,7 @@ c10::intrusive_ptr<TensorImpl> TensorWrapper::shallow_copy_and_detach(
 c10::intrusive_ptr<TensorImpl> TensorWrapper::shallow_copy_and_detach(
     c10::VariableVersion&& version_counter,
     bool allow_tensor_metadata_change) const {
-  auto dest_impl = makeTensorWrapperPtr(value(), level_, is_alive());
+  auto dest_impl = makeTensorWrapperPtr(value(), level_, generation_);
   dest_impl->set_version_counter(version_counter);
 
   // TODO: is this even right?
@@ -120,12 +116,12 @@ TensorWrapper::TensorWrapper(
     c10::DispatchKeySet key_set,
     Tensor value,
     int64_t level,
-    std::shared_ptr<bool> is_alive,
+    uint64_t generation,
     bool use_value_sizes_strides)
   : TensorImpl(key_set, value.dtype(), value.device())
   , value_(std::move(value))
   , level_(level)
-  , is_alive_(std::move(is_alive))
+  , generation_(generation)
 {
   TORCH_INTERNAL_ASSERT(value_.defined());
 
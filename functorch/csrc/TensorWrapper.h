@@ -16,7 +16,7 @@ struct TORCH_API TensorWrapper : public c10::TensorImpl {
       c10::DispatchKeySet key_set,
       Tensor value,
       int64_t level,
-      std::shared_ptr<bool> is_alive,
+      uint64_t generation,
       bool use_value_sizes_strides = true);
 
   // Override a bunch of methods inherited from TensorImpl to return error messages
@@ -51,11 +51,12 @@ struct TORCH_API TensorWrapper : public c10::TensorImpl {
   Tensor value_;
   int64_t level_;
 
-  // When we exit the level, this wrapper may be marked as "not alive".
+  // When we exit the level, this wrapper is no longer alive, which is when
+  // the generation of the level moves on (see isLevelAlive).
   // Wrappers that are not alive:
   // 1) May still have autograd metadata on them
   // 2) Forward dispatches to the underlying value()
-  std::shared_ptr<bool> is_alive_;
+  uint64_t generation_;
 };
 
 TORCH_API Tensor makeTensorWrapper(const Tensor& tensor, int64_t level);
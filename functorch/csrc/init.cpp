@@ -273,6 +273,27 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
   m.def("_set_vmap_fallback_warning_enabled", &at::functorch::setVmapFallbackWarningEnabled, "Set vmap fallback warnings");
   m.def("_set_vmap_fallback_enabled", &at::functorch::setVmapFallbackEnabled);
   m.def("_is_vmap_fallback_enabled", &at::functorch::isVmapFallbackEnabled);
+  m.def("_set_vmap_batched_call_fallback_enabled", &at::functorch::setVmapBatchedCallFallbackEnabled);
+  m.def("_is_vmap_batched_call_fallback_enabled", &at::functorch::isVmapBatchedCallFallbackEnabled);
+  m.def("_set_vmap_parallel_fallback_enabled", &at::functorch::setVmapParallelFallbackEnabled);
+  m.def("_is_vmap_parallel_fallback_enabled", &at::functorch::isVmapParallelFallbackEnabled);
+  m.def("_set_vmap_fallback_profiling_enabled", &at::functorch::setVmapFallbackProfilingEnabled);
+  m.def("_is_vmap_fallback_profiling_enabled", &at::functorch::isVmapFallbackProfilingEnabled);
+  m.def("_reset_vmap_fallback_profile", &at::functorch::resetVmapFallbackProfile);
+  m.def("_get_vmap_fallback_profile", []() {
+    std::map<std::string, std::map<std::string, int64_t>> result;
+    for (const auto& entry : at::functorch::getVmapFallbackProfile()) {
+      result[entry.first] = {
+        {"num_calls", entry.second.num_calls},
+        {"num_slices", entry.second.num_slices},
+        {"total_time_ns", entry.second.total_time_ns},
+        {"bytes_materialized", entry.second.bytes_materialized},
+        {"num_parallel_calls", entry.second.num_parallel_calls},
+      };
+    }
+    return result;
+  });
+  m.def("_dump_vmap_fallback_profile", &at::functorch::dumpVmapFallbackProfileJson);
   m.def("dlevel", &at::functorch::dlevel, "dlevel");
   m.def("dump_tensor", &at::functorch::dump_tensor, "dump_tensor");
   m.def("reshape_dim_into", &at::functorch::reshape_dim_into);
@@ -1,9 +1,12 @@
+import os
+import tempfile
+import unittest
 import torch
 
 import functorch
 from torch.testing._internal.common_utils import run_tests, TestCase
 
-from functorch.compile import aot_function, nop
+from functorch.compile import aot_function, nop, persistent_compile, ts_compile
 
 
 class TestCompileCache(TestCase):
@@ -158,6 +161,105 @@ class TestCompileCache(TestCase):
             args = [torch.randn(10, requires_grad=True) for _ in range(100)]
             check(args, aot_autograd_f, f)
 
+    def test_many_entries(self):
+        # Enough entries to force the cache table to grow several times.
+        cache = functorch._C.CompileCache()
+        hasher = functorch._C.HasherType.StaticShapeHasher
+        for s in range(1, 200):
+            a = torch.randn(s, 2)
+            assert cache.at(0, 0, 0, 1, hasher, a) is None
+            cache.insert(0, 0, 0, 1, hasher, s, a)
+        assert cache.size() == 199
+
+        for s in range(1, 200):
+            a = torch.randn(s, 2)
+            assert cache.at(0, 0, 0, 1, hasher, a) == s
+            assert cache.at(1, 0, 0, 1, hasher, a) is None
+        assert cache.at(0, 0, 0, 1, hasher, None) is None
+
+        cache.clear()
+        assert cache.size() == 0
+        assert cache.at(0, 0, 0, 1, hasher, torch.randn(1, 2)) is None
+
+    def test_eviction(self):
+        cache = functorch._C.CompileCache()
+        hasher = functorch._C.HasherType.StaticShapeHasher
+        cache.set_capacity(max_entries=4)
+        for s in range(1, 11):
+            a = torch.randn(s)
+            assert cache.at(0, 0, 0, 1, hasher, a) is None
+            cache.insert(0, 0, 0, 1, hasher, s, a, nbytes=100)
+            # Keep the first entry hot so that it never gets evicted.
+            assert cache.at(0, 0, 0, 1, hasher, torch.randn(1)) == 1
+        stats = cache.stats()
+        assert stats["size"] == 4
+        assert stats["bytes"] == 400
+        assert stats["evictions"] == 6
+        assert stats["misses"] == 10
+        assert stats["hits"] == 10
+        assert cache.at(0, 0, 0, 1, hasher, torch.randn(10)) == 10
+
+        cache.set_capacity(max_bytes=250)
+        assert cache.size() == 2
+        assert cache.stats()["bytes"] == 200
+
+        # An entry that can never fit is not cached, and evicts nothing
+        a = torch.randn(11)
+        cache.insert(0, 0, 0, 1, hasher, 11, a, nbytes=300)
+        assert cache.at(0, 0, 0, 1, hasher, a) is None
+        stats = cache.stats()
+        assert stats["size"] == 2
+        assert stats["rejected"] == 1
+        assert stats["evictions"] == 8
+
+    def test_bounded_compile_cache(self):
+        def fn(x):
+            return x.sin()
+
+        functorch.compile.clear_compile_cache()
+        functorch.compile.set_compile_cache_capacity(max_entries=1)
+        try:
+            aot_fn = aot_function(fn, nop, nop)
+            for s in [2, 3, 2]:
+                a = torch.randn(s, requires_grad=True)
+                self.assertEqual(aot_fn(a), fn(a))
+            stats = functorch.compile.compile_cache_stats()
+            assert stats["misses"] == 3
+            assert stats["evictions"] == 2
+            assert functorch.compile.num_of_recompilations() == 1
+        finally:
+            functorch.compile.set_compile_cache_capacity()
+            functorch.compile.clear_compile_cache()
+
+    # ts_compile moves tensor constants to the GPU
+    @unittest.skipIf(not torch.cuda.is_available(), "CUDA is unavailable")
+    def test_bounded_compile_cache_ts_compile(self):
+        # ts_compile freezes the graphs, which inlines the weights as constants
+        weight = torch.randn(256, 256, device="cuda")
+        weight_nbytes = weight.numel() * weight.element_size()
+
+        def fn(x):
+            return (x @ weight).sin()
+
+        functorch.compile.clear_compile_cache()
+        functorch.compile.set_compile_cache_capacity(max_bytes=3 * weight_nbytes)
+        try:
+            aot_fn = aot_function(fn, ts_compile, ts_compile)
+            for s in [2, 3, 4]:
+                a = torch.randn(s, 256, device="cuda", requires_grad=True)
+                self.assertEqual(aot_fn(a), fn(a))
+            stats = functorch.compile.compile_cache_stats()
+            assert stats["misses"] == 3
+            assert stats["evictions"] > 0
+            assert weight_nbytes <= stats["bytes"] <= 3 * weight_nbytes
+        finally:
+            functorch.compile.set_compile_cache_capacity()
+            functorch.compile.clear_compile_cache()
+
+    def test_unknown_hasher_type(self):
+        with self.assertRaisesRegex(ValueError, "Unknown hasher_type"):
+            aot_function(lambda x: x, nop, nop, hasher_type="ShapeHasher")
+
     def test_multiple_compiler(self):
         def fn(x, bias):
             return x + bias
@@ -678,5 +780,75 @@ class TestCompileCacheStaticArgs(TestCase):
         assert total_recomps == 7
 
 
+class TestPersistentCompileCache(TestCase):
+    def test_reuse_across_processes(self):
+        num_compiles = 0
+
+        def script_compile(fx_g, _):
+            nonlocal num_compiles
+            num_compiles += 1
+            return torch.jit.script(fx_g)
+
+        def fn(x, y):
+            return (x * y).sin()
+
+        def run(cache_dir, shape):
+            # A fresh in-memory cache and compiler, as in a new process.
+            functorch.compile.clear_compile_cache()
+            compiler = persistent_compile(script_compile, cache_dir)
+            aot_fn = aot_function(fn, compiler, compiler)
+            a = torch.randn(shape, requires_grad=True)
+            b = torch.randn(shape, requires_grad=True)
+            res = aot_fn(a, b)
+            res.sum().backward()
+            self.assertEqual(res, fn(a, b))
+            self.assertEqual(a.grad, b * (a * b).cos())
+
+        with tempfile.TemporaryDirectory() as cache_dir:
+            run(cache_dir, 4)
+            assert num_compiles == 2
+            run(cache_dir, 4)
+            assert num_compiles == 2
+
+            # Other input properties don't hit the cached entries.
+            run(cache_dir, 5)
+            assert num_compiles == 4
+
+            # Unreadable entries are recompiled and overwritten.
+            for name in os.listdir(cache_dir):
+                with open(os.path.join(cache_dir, name), "wb") as f:
+                    f.write(b"garbage")
+            run(cache_dir, 4)
+            assert num_compiles == 6
+            run(cache_dir, 4)
+            assert num_compiles == 6
+        functorch.compile.clear_compile_cache()
+
+    def test_unwritable_cache_dir(self):
+        def fn(x):
+            return x.sin()
+
+        with tempfile.TemporaryDirectory() as tmp:
+            # A file where the cache directory should be, so saving fails.
+            not_a_dir = os.path.join(tmp, "file")
+            open(not_a_dir, "w").close()
+            functorch.compile.clear_compile_cache()
+            compiler = persistent_compile(
+                lambda fx_g, _: torch.jit.script(fx_g), os.path.join(not_a_dir, "cache")
+            )
+            aot_fn = aot_function(fn, compiler, compiler)
+            a = torch.randn(4, requires_grad=True)
+            with self.assertWarnsRegex(UserWarning, "not caching") as w:
+                res = aot_fn(a)
+                res.sum().backward()
+            self.assertEqual(res, fn(a))
+            self.assertEqual(a.grad, a.cos())
+            # Warned once, for the forward and backward compiles together.
+            self.assertEqual(
+                sum("not caching" in str(x.message) for x in w.warnings), 1
+            )
+        functorch.compile.clear_compile_cache()
+
+
 if __name__ == "__main__":
     run_tests()
@@ -13,6 +13,7 @@ import torch.nn.functional as F
 import unittest
 import warnings
 import math
+import threading
 from torch.testing._internal.common_device_type import instantiate_device_type_tests, onlyCPU
 from torch.testing._internal.common_dtype import get_all_fp_dtypes
 from functools import partial
@@ -268,6 +269,41 @@ class TestGradTransform(TestCase):
         result = grad(foo)(x)
         self.assertEqual(result, x.cos())
 
+    def test_grad_on_concurrent_threads(self, device):
+        barrier = threading.Barrier(2, timeout=10)
+        results = [None, None]
+
+        def foo(x):
+            # Both threads are inside a grad transform at the same level here
+            barrier.wait()
+            return x.sin().sum()
+
+        def run(idx):
+            x = torch.randn(3, device=device)
+            results[idx] = (grad(foo)(x), x.cos())
+
+        threads = [threading.Thread(target=run, args=(idx,)) for idx in range(2)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for result, expected in results:
+            self.assertEqual(result, expected)
+
+    def test_inplace_changes_metadata(self, device):
+        x = torch.randn(2, 3, device=device)
+        w = torch.randn(1, 3, 2, device=device)
+
+        def foo(x):
+            y = x.clone()
+            y.t_()
+            y.unsqueeze_(0)
+            self.assertEqual(y.shape, (1, 3, 2))
+            return (y * w).sum()
+
+        result = grad(foo)(x)
+        self.assertEqual(result, w[0].t())
+
     def test_inplace_on_view(self, device):
         x = torch.randn(3, device=device)
 
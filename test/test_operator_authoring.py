@@ -1,5 +1,11 @@
+import os
+import tempfile
 import torch
 import unittest
+import unittest.mock
+
+from concurrent.futures import ThreadPoolExecutor
+from typing import Union
 
 from torch import fx
 from functorch.compile import pointwise_operator
@@ -109,6 +115,315 @@ class TestOperatorAuthoring(JitTestCase):
         torch.testing.assert_allclose(a1, a2)
         torch.testing.assert_allclose(b1, b2)
 
+    @unittest.skipIf(not HAS_SYMPY, "currently requires sympy")
+    def test_backwards_fused(self):
+        from functorch._src import operator_authoring
+        backwards = []
+        make_backwards = operator_authoring.PointwiseCompiler.make_backwards
+
+        def recording_make_backwards(compiler, indices):
+            saved, kernel = make_backwards(compiler, indices)
+            backwards.append((list(indices), saved, kernel))
+            return saved, kernel
+
+        def grads(fn):
+            a = self.rand(4, 2, requires_grad=True)
+            b = self.rand(4, 2, requires_grad=True)
+            result = fn(a, b)
+            # A single node computes the grads of both inputs
+            self.assertEqual(len(result.grad_fn.next_functions), 2)
+            result.sum().backward()
+            return a.grad, b.grad
+
+        def fn1(a, b):
+            return a * b + a
+
+        def fn2(a, b):
+            return a * a + b
+
+        # The grads of fn2 don't read b
+        for fn, expected_saved in [(fn1, [0, 1]), (fn2, [0])]:
+            del backwards[:]
+            torch.manual_seed(0)
+            a1, b1 = grads(fn)
+            torch.manual_seed(0)
+            with unittest.mock.patch.object(
+                operator_authoring.PointwiseCompiler,
+                "make_backwards",
+                recording_make_backwards,
+            ):
+                a2, b2 = grads(pointwise_operator(fn))
+            torch.testing.assert_allclose(a1, a2)
+            torch.testing.assert_allclose(b1, b2)
+
+            # One backward kernel, with an output per input grad, which only
+            # saves the inputs it reads.
+            ((indices, saved, kernel),) = backwards
+            self.assertEqual(indices, [0, 1])
+            self.assertEqual(saved, expected_saved)
+            self.assertEqual(len(kernel.cached_kernels()), 1)
+            args = [self.rand(4, 2) for _ in range(len(saved) + 1)]
+            self.assertEqual(len(kernel(*args)), 2)
+
+    @unittest.skipIf(not HAS_SYMPY, "currently requires sympy")
+    def test_backwards_scalar_args(self):
+        def fn(a, b, alpha: float = 1.0, n: int = 2):
+            return a * b * alpha + a * n
+
+        def grads(fn, alpha, n):
+            torch.manual_seed(0)
+            a = self.rand(4, 2, requires_grad=True)
+            b = self.rand(4, 2, requires_grad=True)
+            fn(a, b, alpha, n).sum().backward()
+            return a.grad, b.grad
+
+        nnc_fn = pointwise_operator(fn)
+        nnc_fn_specialized = pointwise_operator(fn, specialize=("alpha",))
+        # The same kernels take the scalars of every call
+        for alpha, n in [(1.0, 2), (0.5, 3), (-2.0, 0)]:
+            a1, b1 = grads(fn, alpha, n)
+            for op in (nnc_fn, nnc_fn_specialized):
+                a2, b2 = grads(op, alpha, n)
+                torch.testing.assert_allclose(a1, a2)
+                torch.testing.assert_allclose(b1, b2)
+
+    def test_multiple_outputs(self):
+        def fn(a, b):
+            return a + b, a * b
+
+        nnc_fn = pointwise_operator(fn, num_outputs=2)
+        a, b = self.rand(4, 3), self.rand(3)
+        for result_nnc, result_aten in zip(nnc_fn(a, b), fn(a, b)):
+            self.assertEqual(result_nnc.size(), result_aten.size())
+            torch.testing.assert_allclose(result_nnc, result_aten)
+        # Few outputs use the fixed size caches rather than the dynamic tier.
+        (kernel,) = nnc_fn.cached_kernels()
+        self.assertEqual(kernel["max_dims"], 2)
+        self.assertFalse(kernel["out"])
+
+    def test_scalar_args(self):
+        specs = []
+
+        def fn(a, b, alpha: float = 1.0, n: int = 2):
+            return a + b * alpha + n
+
+        @pointwise_operator
+        def nnc_fn(a, b, alpha: float = 1.0, n: int = 2):
+            specs.append(None)
+            return a + b * alpha + n
+
+        a, b = self.rand(4, 3), self.rand(4, 3)
+        for alpha, n in [(1.0, 2), (0.5, 3), (-2.0, 0)]:
+            torch.testing.assert_allclose(nnc_fn(a, b, alpha, n=n), fn(a, b, alpha, n))
+        torch.testing.assert_allclose(nnc_fn(a, b), fn(a, b))
+        # scalars aren't specialized on, so the kernel is only traced once
+        self.assertEqual(len(specs), 1)
+
+    def test_specialized_scalar_args(self):
+        def fn(a, alpha: float):
+            return a * alpha
+
+        nnc_fn = pointwise_operator(fn, specialize=("alpha",))
+        a = self.rand(4, 3)
+        for alpha in [1.0, 2.0, 1.0]:
+            torch.testing.assert_allclose(nnc_fn(a, alpha), fn(a, alpha))
+
+    def test_overloads(self):
+        def fn(a, b: Union[torch.Tensor, float]):
+            return a * b + 1
+
+        nnc_fn = pointwise_operator(fn)
+        a, b = self.rand(4, 3), self.rand(4, 3)
+        torch.testing.assert_allclose(nnc_fn(a, b), fn(a, b))
+        torch.testing.assert_allclose(nnc_fn(a, 3.0), fn(a, 3.0))
+        out = torch.empty_like(a)
+        nnc_fn(a, 3.0, out=out)
+        torch.testing.assert_allclose(out, fn(a, 3.0))
+
+    def test_reductions(self):
+        def fn(a, b):
+            return a * b + 1
+
+        a, b = self.rand(2, 3, 8), self.rand(8)
+        for reduce in ("sum", "mean", "amax", "amin"):
+            nnc_fn = pointwise_operator(fn, reduce=reduce)
+            ref = getattr(torch, reduce)
+            for x in (a, a.transpose(0, 1), a[:, :1]):
+                result = nnc_fn(x, b)
+                self.assertEqual(result.size(), x.size()[:-1])
+                torch.testing.assert_allclose(result, ref(fn(x, b), -1))
+
+        nnc_fn = pointwise_operator(fn, reduce="sum")
+        result = nnc_fn(a.int(), b.int())
+        self.assertEqual(result.dtype, torch.int64)
+        torch.testing.assert_allclose(result, torch.sum(fn(a.int(), b.int()), -1))
+
+    def test_threads(self):
+        # Threads concurrently hitting and filling the kernel cache.
+        def run(n):
+            for _ in range(10):
+                self.check(self.rand(n, 3), self.rand(n, 1))
+                self.check(self.rand(2, n, 3), self.rand(1, 3))
+
+        with ThreadPoolExecutor(max_workers=4) as executor:
+            for future in [executor.submit(run, n) for n in range(1, 9)]:
+                future.result()
+
+    def test_many_dims(self):
+        self.check(self.rand(2, 1, 2, 1, 2, 1, 2, 1, 2, 3), self.rand(3))
+        self.check(self.rand(2, 2, 2, 2, 2, 2, 2, 2, 2).transpose(0, 8), self.rand(2, 1))
+
+    def test_many_args(self):
+        def fn(a, b, c, d, e, f, g, h, i, j):
+            return a + b * c - d + e * f - g + h * i - j
+
+        nnc_fn = pointwise_operator(fn)
+        args = [self.rand(4, 3) for _ in range(9)] + [self.rand(3)]
+        torch.testing.assert_allclose(nnc_fn(*args), fn(*args))
+        args = [self.rand(2, 2, 2, 2, 2, 2, 2, 2, 2) for _ in range(10)]
+        torch.testing.assert_allclose(nnc_fn(*args), fn(*args))
+
+    def test_collapse_dims(self):
+        from functorch._src import operator_authoring
+        specs = []
+        compiler = operator_authoring.PointwiseCompiler
+
+        def counting_compiler(name, module_name, fn, spec, *args):
+            specs.append(spec)
+            return compiler(name, module_name, fn, spec, *args)
+
+        def fn(a, b):
+            return a * b + a
+
+        with unittest.mock.patch.object(operator_authoring, "PointwiseCompiler", counting_compiler):
+            nnc_fn = pointwise_operator(fn)
+            for shape in [(2, 3, 4, 5), (6, 20), (120,)]:
+                a, b = self.rand(*shape), self.rand(*shape)
+                result = nnc_fn(a, b)
+                self.assertEqual(result.size(), a.size())
+                self.assertEqual(result.stride(), a.stride())
+                torch.testing.assert_allclose(result, fn(a, b))
+                out = torch.empty_like(a)
+                self.assertIs(nnc_fn(a, b, out=out), out)
+                torch.testing.assert_allclose(out, fn(a, b))
+
+        # one allocating and one out variant kernel, both 1-d
+        self.assertEqual(len(specs), 2)
+        self.assertTrue(all(key.ndim == 1 for spec in specs for key in spec))
+
+    def test_out_disjoint_view(self):
+        buf = self.rand(2, 16)
+        a, b, out = buf[0], self.rand(16), buf[1]
+        expected = pointwise_fn(a, b)
+        nnc_pointwise_fn(a, b, out=out)
+        torch.testing.assert_allclose(out, expected)
+
+        buf = self.rand(32)
+        a, b, out = buf[0::2], self.rand(16), buf[1::2]
+        expected = pointwise_fn(a, b)
+        nnc_pointwise_fn(a, b, out=out)
+        torch.testing.assert_allclose(out, expected)
+
+    def test_profiler(self):
+        @pointwise_operator
+        def profiled_fn(a, b):
+            return a * 2 + b
+
+        a, b = self.rand(8, 16), self.rand(16)
+        with torch.autograd.profiler.profile(record_shapes=True) as prof:
+            profiled_fn(a, b)
+            profiled_fn(a, b)
+        events = [e for e in prof.function_events if e.name == "profiled_fn"]
+        self.assertEqual(len(events), 2)
+        # The tensors, then the specialization key summary of the kernel
+        for event in events:
+            self.assertEqual(event.input_shapes, [[8, 16], [16], []])
+        compiles = [e for e in prof.function_events if e.name == "profiled_fn::compile"]
+        self.assertEqual(len(compiles), 1)
+
+    def test_precompile(self):
+        traces = []
+
+        @pointwise_operator
+        def nnc_fn(a, b):
+            traces.append(None)
+            return a * b + 1
+
+        # small examples stand in for tensors of any size with the same layout
+        a, b = self.rand(2, 3), self.rand(3)
+        nnc_fn.precompile([(a, b), (a.t(), a.t())])
+        nnc_fn.precompile([((a, b), {"out": a.clone()})], background=True).result()
+        self.assertEqual(len(traces), 3)
+
+        x, y = self.rand(64, 32), self.rand(32)
+        torch.testing.assert_allclose(nnc_fn(x, y), x * y + 1)
+        torch.testing.assert_allclose(nnc_fn(x.t(), x.t()), x.t() * x.t() + 1)
+        out = torch.empty_like(x)
+        nnc_fn(x, y, out=out)
+        torch.testing.assert_allclose(out, x * y + 1)
+        self.assertEqual(len(traces), 3)
+
+    def test_precompile_background_no_grad(self):
+        traces = []
+
+        @pointwise_operator
+        def nnc_fn(a, b):
+            traces.append(None)
+            return a * b + 1
+
+        a = self.rand(2, 3, requires_grad=True)
+        b = self.rand(3)
+        with torch.no_grad():
+            nnc_fn.precompile([(a, b)], background=True).result()
+            self.assertEqual(len(traces), 1)
+            # The background compile used the caller's grad mode
+            torch.testing.assert_allclose(nnc_fn(a, b), a * b + 1)
+        self.assertEqual(len(traces), 1)
+
+    def test_save_cached_kernels(self):
+        traces = []
+
+        def fn(a, b):
+            traces.append(None)
+            return a * b + 1
+
+        a, b = self.rand(8, 4), self.rand(4)
+        nnc_fn = pointwise_operator(fn)
+        for _ in range(3):
+            nnc_fn(a, b)
+        nnc_fn(a.t(), a.t())
+        kernels = sorted(nnc_fn.cached_kernels(), key=lambda k: k["hits"])
+        self.assertEqual([k["hits"] for k in kernels], [0, 2])
+        self.assertEqual([len(k["spec"]) for k in kernels], [2, 2])
+        self.assertTrue(all(k["compile_time"] > 0 for k in kernels))
+
+        expected = [fn(a, b), fn(a.t(), a.t())]
+        del traces[:]
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "kernels.json")
+            nnc_fn.save_cached_kernels(path)
+            nnc_fn = pointwise_operator(fn)
+            nnc_fn.load_cached_kernels(path, background=True).result()
+        self.assertEqual(len(traces), 2)
+        torch.testing.assert_allclose(nnc_fn(a, b), expected[0])
+        torch.testing.assert_allclose(nnc_fn(a.t(), a.t()), expected[1])
+        self.assertEqual(len(traces), 2)
+
+    def test_gil_release_stats(self):
+        nnc_fn = pointwise_operator(lambda a, b: a * b + 1)
+        a, b = self.rand(64, 32), self.rand(32)
+        for _ in range(40):
+            torch.testing.assert_allclose(nnc_fn(a, b), a * b + 1)
+        (kernel,) = nnc_fn.cached_kernels()
+        self.assertEqual(kernel["timed_calls"], 32)
+        self.assertGreater(kernel["ns_per_element"], 0)
+        self.assertGreater(kernel["gil_release_ns"], 0)
+        # Keeps timing one call in 1024
+        for _ in range(1025 - 40):
+            nnc_fn(a, b)
+        (kernel,) = nnc_fn.cached_kernels()
+        self.assertEqual(kernel["timed_calls"], 33)
+
     def test_torch_function(self):
         self.check(self.rand(10), TorchFunctionExample())
 
@@ -11,6 +11,7 @@ import torch.nn.functional as F
 from torch import Tensor
 import functools
 import itertools
+import json
 import warnings
 import unittest
 from torch.testing._internal.common_device_type import instantiate_device_type_tests, \
@@ -49,6 +50,35 @@ class EnableVmapFallbackWarnings:
         torch._C._debug_only_display_vmap_fallback_warnings(self.prev_state)
 
 
+class DisableVmapBatchedCallFallback:
+    def __enter__(self):
+        self.prev_state = functorch._C._is_vmap_batched_call_fallback_enabled()
+        functorch._C._set_vmap_batched_call_fallback_enabled(False)
+
+    def __exit__(self, *ignored):
+        functorch._C._set_vmap_batched_call_fallback_enabled(self.prev_state)
+
+
+class EnableVmapParallelFallback:
+    def __enter__(self):
+        self.prev_state = functorch._C._is_vmap_parallel_fallback_enabled()
+        functorch._C._set_vmap_parallel_fallback_enabled(True)
+
+    def __exit__(self, *ignored):
+        functorch._C._set_vmap_parallel_fallback_enabled(self.prev_state)
+
+
+class EnableVmapFallbackProfiling:
+    def __enter__(self):
+        self.prev_state = functorch._C._is_vmap_fallback_profiling_enabled()
+        functorch._C._set_vmap_fallback_profiling_enabled(True)
+        functorch._C._reset_vmap_fallback_profile()
+
+    def __exit__(self, *ignored):
+        functorch._C._set_vmap_fallback_profiling_enabled(self.prev_state)
+        functorch._C._reset_vmap_fallback_profile()
+
+
 class TestVmapAPI(TestCase):
     def test_non_tensor_output_raises(self):
         with self.assertRaisesRegex(ValueError, "got type <class 'float'> as a return"):
@@ -664,6 +694,125 @@ class TestVmapAPI(TestCase):
         result = vmap(vmap(vmap(op)))(x, y)
         self.assertEqual(result, op(x, y.view(100, 10, 10, 1)))
 
+    def test_fallback_batched_call(self):
+        # torch.copysign is recorded as a pointwise batched-call op and
+        # max_unpool2d as a leading-batch-dim op, so both of them skip the
+        # per-slice for-loop. The result must match the for-loop.
+        def check(op, in_dims, *args):
+            result = vmap(op, in_dims)(*args)
+            with DisableVmapBatchedCallFallback():
+                expected = vmap(op, in_dims)(*args)
+            self.assertEqual(result, expected)
+
+        x = torch.randn(5, 7, 11)
+        y = torch.randn(7, 11)
+        check(torch.copysign, (0, None), x, y)
+        check(torch.copysign, (2, 0), torch.randn(7, 11, 5), torch.randn(5, 11))
+        check(torch.copysign, (0, None), torch.randn(5), torch.randn(3, 2))
+        check(torch.copysign, (0, None), torch.randn(5, dtype=torch.double), torch.randn(3))
+        check(torch.copysign, (0, None), x, 2.)
+        check(vmap(torch.copysign), (0, 1), x, torch.randn(7, 5, 11))
+
+        x, indices = F.max_pool2d(torch.randn(10, 3, 4, 4), 2, return_indices=True)
+        x, indices = x.view(5, 2, 3, 2, 2), indices.view(5, 2, 3, 2, 2)
+        check(F.max_unpool2d, (0, 0, None), x, indices, 2)
+        check(F.max_unpool2d, (1, 1, None), x.movedim(0, 1), indices.movedim(0, 1), 2)
+
+    def test_fallback_preallocated_outputs(self):
+        # The for-loop writes every slice into a preallocated output (through
+        # copysign.out) unless the results require grad, in which case the
+        # slices get stacked.
+        op = torch.copysign
+        x = torch.randn(257, 3, 5)
+        y = torch.randn(5)
+        with DisableVmapBatchedCallFallback():
+            result = vmap(op, (0, None))(x, y)
+            self.assertEqual(result, op(x, y))
+
+            result = vmap(vmap(op), (1, None))(x, y)
+            self.assertEqual(result, op(x.movedim(1, 0), y))
+
+            x = torch.randn(7, 5, requires_grad=True)
+            result = vmap(op, (0, None))(x, y)
+            self.assertEqual(result, op(x, y))
+            result.sum().backward()
+            self.assertEqual(x.grad, torch.sign(x) * torch.sign(y))
+
+    def test_fallback_parallel(self):
+        # Running the slices on the intra-op thread pool must not change the
+        # results, for both the out-of-place and in-place fallbacks.
+        prev_num_threads = torch.get_num_threads()
+        torch.set_num_threads(max(prev_num_threads, 2))
+        try:
+            self._test_fallback_parallel()
+        finally:
+            torch.set_num_threads(prev_num_threads)
+
+    def _test_fallback_parallel(self):
+        def num_parallel_calls(op_name):
+            profile = functorch._C._get_vmap_fallback_profile()
+            return profile[op_name]['num_parallel_calls']
+
+        op = torch.copysign
+        x = torch.randn(64, 3, 5)
+        y = torch.randn(64, 5)
+        with DisableVmapBatchedCallFallback():
+            expected = vmap(vmap(op), (1, None))(x, y)
+            with EnableVmapParallelFallback(), EnableVmapFallbackProfiling():
+                result = vmap(vmap(op), (1, None))(x, y)
+                self.assertGreater(num_parallel_calls('aten::copysign.Tensor'), 0)
+        self.assertEqual(result, expected)
+        self.assertEqual(result, op(x.movedim(1, 0), y))
+
+        x_orig = torch.randn(7, 11, 64)
+        x = x_orig.clone()
+        y = torch.randn(64, 7, 11)
+        with EnableVmapParallelFallback(), EnableVmapFallbackProfiling():
+            vmap(Tensor.atan2_, (2, 0))(x, y)
+            self.assertEqual(num_parallel_calls('aten::atan2_'), 1)
+        self.assertEqual(x, torch.atan2(x_orig, y.movedim(0, 2)))
+
+        # Slices that read memory other slices write to must run serially,
+        # in order, whether the aliased argument is batched or not.
+        cases = [
+            ((0, 0), lambda base: (base[1:], base[:-1])),
+            ((0, None), lambda base: (base, base[0])),
+        ]
+        for in_dims, make_args in cases:
+            base = torch.randn(65, 5)
+            expected_self, expected_other = make_args(base.clone())
+            for i in range(len(expected_self)):
+                other = expected_other if in_dims[1] is None else expected_other[i]
+                expected_self[i].atan2_(other)
+            with EnableVmapParallelFallback(), EnableVmapFallbackProfiling():
+                vmap(Tensor.atan2_, in_dims)(*make_args(base))
+                self.assertEqual(num_parallel_calls('aten::atan2_'), 0)
+            self.assertEqual(make_args(base)[0], expected_self)
+
+    def test_fallback_profiler(self):
+        x = torch.randn(5, 3)
+        y = torch.randn(3)
+        with EnableVmapFallbackProfiling():
+            with DisableVmapBatchedCallFallback():
+                vmap(torch.copysign, (0, None))(x, y)
+                vmap(torch.copysign, (0, None))(x, y)
+            vmap(Tensor.atan2_)(x.clone(), x)
+
+            profile = functorch._C._get_vmap_fallback_profile()
+            stats = profile['aten::copysign.Tensor']
+            self.assertEqual(stats['num_calls'], 2)
+            self.assertEqual(stats['num_slices'], 10)
+            self.assertEqual(stats['bytes_materialized'], 2 * x.numel() * x.element_size())
+            self.assertGreater(stats['total_time_ns'], 0)
+            self.assertEqual(profile['aten::atan2_']['num_slices'], 5)
+            self.assertEqual(profile['aten::atan2_']['bytes_materialized'], 0)
+
+            dumped = json.loads(functorch._C._dump_vmap_fallback_profile())
+            self.assertEqual(dumped, profile)
+
+            functorch._C._reset_vmap_fallback_profile()
+            self.assertEqual(functorch._C._get_vmap_fallback_profile(), {})
+
     # TODO: No clue what is wrong here.
     @unittest.skip
     def test_fallback_masked_fill(self):